@@ -6,23 +6,157 @@
 #pragma once
 #include <pl32-memory.h>
 
+/* Default size of the read/write buffer of actual files */
+#define PLF_BUFSIZE 65536
+/* Smallest amount of memory that a file in memory allocates on its first write */
+#define PLF_MEMSIZE 4096
+
 typedef struct plfile plfile_t;
+typedef struct plfaio plfaio_t;
+
+/* When the write buffer of an actual file gets flushed */
+typedef enum plfflush {
+	PLF_FLUSH_FULL = 0, /* Only when the buffer is full */
+	PLF_FLUSH_LINE = 1, /* Also whenever a newline is written */
+	PLF_FLUSH_NONE = 2, /* Every write goes straight to the file */
+} plfflush_t;
+
+/* How a file stream is going to be accessed, passed to plFAdvise */
+typedef enum plfadvice {
+	PLF_ADVISE_NORMAL = 0,
+	PLF_ADVISE_SEQUENTIAL = 1, /* Read from start to end, so the kernel reads further ahead */
+	PLF_ADVISE_RANDOM = 2, /* Read in no particular order, so the kernel doesn't read ahead */
+	PLF_ADVISE_WILLNEED = 3, /* Going to be read soon, so the kernel starts reading it in now */
+	PLF_ADVISE_DONTNEED = 4, /* Not going to be read again, so the kernel can drop it from its cache */
+} plfadvice_t;
+
+/* What an asynchronous I/O context runs its requests on */
+typedef enum plfaiobackend {
+	PLF_AIO_AUTO = 0, /* io_uring if the kernel allows it, a thread pool otherwise */
+	PLF_AIO_URING = 1,
+	PLF_AIO_THREADS = 2,
+} plfaiobackend_t;
+
+/* Finished asynchronous request. buffer holds the data of a successful read, which was *\
+\* allocated from the memory tracker of the stream. result is negative errno on failure  */
+typedef struct plfaioresult {
+	plfile_t* stream;
+	memptr_t userData;
+	plarray_t buffer;
+	int64_t result;
+} plfaioresult_t;
+
+/* Buffer window at the start of every plfile_t. It's public so byte and line operations can *\
+|* be inlined, and it must not be modified directly. Only one of the read window or the write *|
+\* window is open at a time. A closed window has both pointers set to NULL                   */
+typedef struct plfilebuf {
+	byte_t* readPos; /* Next byte to be read */
+	byte_t* readEnd; /* End of the bytes that can be read without a refill */
+	byte_t* writePos; /* Where the next byte gets written */
+	byte_t* writeEnd; /* End of the space that can be written without a flush */
+	bool isLineFlushed; /* Newlines have to go through plFPutCSlow and plFPutsSlow */
+} plfilebuf_t;
 
 plfile_t* plFOpen(string_t filename, string_t mode, plmt_t* mt);
 plfile_t* plFToP(FILE* pointer, string_t mode, plmt_t* mt);
+plfile_t* plFOpenCompressed(plfile_t* base, string_t mode, bool closeBase);
+int plFPipe(plfile_t* ends[2], size_t capacity, bool isBlocking, plmt_t* mt);
 int plFClose(plfile_t* ptr);
 
+int plFSetBuf(plfile_t* stream, size_t size, plfflush_t flushMode);
+int plFFlush(plfile_t* stream);
+int plFReserve(plfile_t* stream, size_t capacity);
+int plFShrink(plfile_t* stream);
+int plFSetSpill(plfile_t* stream, size_t spillSize);
+int plFAdvise(plfile_t* stream, plfadvice_t advice);
+int plFSetReadahead(plfile_t* stream, size_t windowSize);
+
 size_t plFRead(memptr_t ptr, size_t size, size_t nmemb, plfile_t* stream);
 size_t plFWrite(memptr_t ptr, size_t size, size_t nmemb, plfile_t* stream);
+size_t plFReadv(plfile_t* stream, const plarray_t* pieces, size_t pieceAmnt);
+size_t plFWritev(plfile_t* stream, const plarray_t* pieces, size_t pieceAmnt);
+
+plarray_t plFPeek(plfile_t* stream, size_t size);
+plarray_t plFView(plfile_t* stream);
+int plFAdvance(plfile_t* stream, size_t size);
+plarray_t plFNextLine(plfile_t* stream);
+
+int plFPutCSlow(byte_t ch, plfile_t* stream);
+int plFGetCSlow(plfile_t* stream);
+int plFPutsSlow(string_t string, plfile_t* stream);
+string_t plFGetsSlow(string_t string, int num, plfile_t* stream);
+
+/* Puts a character into the file stream */
+inline int plFPutC(byte_t ch, plfile_t* stream){
+	plfilebuf_t* buf = (plfilebuf_t*)stream;
+
+	if(buf != NULL && buf->writePos < buf->writeEnd && (ch != '\n' || !buf->isLineFlushed)){
+		*buf->writePos++ = ch;
+		return ch;
+	}
+
+	return plFPutCSlow(ch, stream);
+}
+
+/* Gets a character from the file stream */
+inline int plFGetC(plfile_t* stream){
+	plfilebuf_t* buf = (plfilebuf_t*)stream;
+
+	if(buf != NULL && buf->readPos < buf->readEnd)
+		return *buf->readPos++;
+
+	return plFGetCSlow(stream);
+}
+
+/* Puts a string into the file stream */
+inline int plFPuts(string_t string, plfile_t* stream){
+	plfilebuf_t* buf = (plfilebuf_t*)stream;
+
+	if(buf != NULL && string != NULL && buf->writePos < buf->writeEnd){
+		size_t size = strlen(string);
+
+		if(size <= (size_t)(buf->writeEnd - buf->writePos) && (!buf->isLineFlushed || memchr(string, '\n', size) == NULL)){
+			memcpy(buf->writePos, string, size);
+			buf->writePos += size;
+			return 0;
+		}
+	}
+
+	return plFPutsSlow(string, stream);
+}
+
+/* Gets a line from the file stream, including its newline */
+inline string_t plFGets(string_t string, int num, plfile_t* stream){
+	plfilebuf_t* buf = (plfilebuf_t*)stream;
+
+	if(buf != NULL && string != NULL && num > 1 && buf->readPos < buf->readEnd){
+		size_t maxSize = buf->readEnd - buf->readPos;
+		if(maxSize > (size_t)num - 1)
+			maxSize = num - 1;
+
+		byte_t* endMark = (byte_t*)memchr(buf->readPos, '\n', maxSize);
+		if(endMark != NULL){
+			size_t lineSize = endMark - buf->readPos + 1;
+
+			memcpy(string, buf->readPos, lineSize);
+			string[lineSize] = '\0';
+			buf->readPos += lineSize;
+			return string;
+		}
+	}
 
-int plFPutC(byte_t ch, plfile_t* stream);
-int plFGetC(plfile_t* stream);
+	return plFGetsSlow(string, num, stream);
+}
 
-int plFPuts(string_t string, plfile_t* stream);
-string_t plFGets(string_t string, int num, plfile_t* stream);
+plfaio_t* plFAioInit(unsigned int queueSize, plfaiobackend_t backend, plmt_t* mt);
+int plFAioStop(plfaio_t* aio);
+int plFReadAsync(plfaio_t* aio, plfile_t* stream, size_t offset, size_t size, memptr_t userData);
+int plFWriteAsync(plfaio_t* aio, plfile_t* stream, size_t offset, memptr_t data, size_t size, memptr_t userData);
+size_t plFAioSubmit(plfaio_t* aio);
+size_t plFAioReap(plfaio_t* aio, plfaioresult_t* results, size_t maxResults, bool wait);
 
 int plFSeek(plfile_t* stream, long int offset, int whence);
 size_t plFTell(plfile_t* stream);
 
 int plFPToFile(string_t filename, plfile_t* stream);
-void plFCat(plfile_t* dest, plfile_t* src, int destWhence, int srcWhence, bool closeSrc);
+size_t plFCat(plfile_t* dest, plfile_t* src, int destWhence, int srcWhence, bool closeSrc);
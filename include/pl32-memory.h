@@ -27,6 +27,17 @@ typedef enum plmtaction {
 	PLMT_GET_USEDMEM = 6,
 	PLMT_GET_MAXMEM = 7,
 	PLMT_SET_MAXMEM = 8,
+	PLMT_GET_CHILDMEM = 9,
+	PLMT_GET_CHILDAMNT = 10,
+	PLMT_GET_CHILDUSEDMEM = 11,
+	PLMT_GET_PEAKMEM = 12,
+	PLMT_GET_LIVEAMNT = 13,
+	PLMT_GET_SOFTMEM = 14,
+	PLMT_SET_SOFTMEM = 15,
+	PLMT_GET_PRESSUREAMNT = 16,
+	PLMT_GET_RETAINMEM = 17,
+	PLMT_SET_RETAINMEM = 18,
+	PLMT_GET_CACHEDMEM = 19,
 } plmtaction_t;
 
 typedef uint8_t byte_t;
@@ -45,6 +56,36 @@ typedef struct plchar {
 	byte_t bytes[4];
 } plchar_t;
 
+/* Allocation statistics of a memory tracker. Bucket i of the histogram counts *\
+\* allocations between 2^i and 2^(i+1) - 1 bytes, the last bucket counts the rest */
+#define PLMT_HISTOGRAM_SIZE 32
+typedef struct plmtstats {
+	size_t allocAmnt;
+	size_t freeAmnt;
+	size_t reallocAmnt;
+	size_t failAmnt; /* Allocations refused because of a memory limit */
+	size_t liveAmnt;
+	size_t peakMemory;
+	size_t histogram[PLMT_HISTOGRAM_SIZE];
+} plmtstats_t;
+
+/* Called when a memory tracker reaches its soft or hard memory limit (See plMTSetPressureCallbacks) */
+typedef void (*plmtpressurefunc_t)(plmt_t* mt, size_t size, memptr_t data);
+
+/* Allocator that a memory tracker gets its blocks from. Blocks have to be aligned to at least *\
+\* 2 * sizeof(size_t) bytes. data is passed as is to every function                          */
+typedef struct plmtbackend {
+	memptr_t (*alloc)(memptr_t data, size_t size, bool zeroed);
+	memptr_t (*realloc)(memptr_t data, memptr_t block, size_t size);
+	void (*free)(memptr_t data, memptr_t block);
+	memptr_t data;
+} plmtbackend_t;
+
+extern const plmtbackend_t plMTMallocBackend;
+extern const plmtbackend_t plMTMmapBackend;
+extern const plmtbackend_t plMTTHPBackend;
+extern const plmtbackend_t plMTHugeTLBBackend;
+
 typedef plfatptr_t plarray_t;
 typedef struct plstring {
 	plarray_t data;
@@ -53,13 +94,38 @@ typedef struct plstring {
 
 void plPanic(string_t msg, bool usePerror, bool developerBug);
 plmt_t* plMTInit(size_t maxMemoryAlloc);
+plmt_t* plMTInitArena(size_t chunkSize, size_t maxMemoryAlloc);
+plmt_t* plMTInitShared(size_t maxMemoryAlloc);
+plmt_t* plMTInitChild(plmt_t* parent, size_t maxMemoryAlloc);
+void plMTReset(plmt_t* mt);
 void plMTStop(plmt_t* mt);
 size_t plMTMemAmnt(plmt_t* mt, plmtaction_t action, size_t size);
+int plMTGetStats(plmt_t* mt, plmtstats_t* stats);
+int plMTSetSizeClasses(plmt_t* mt, size_t* sizeClasses, size_t amount);
+int plMTSetBackend(plmt_t* mt, const plmtbackend_t* backend);
+int plMTChargeExternal(plmt_t* mt, size_t size);
+void plMTUnchargeExternal(plmt_t* mt, size_t size);
+int plMTSetPressureCallbacks(plmt_t* mt, plmtpressurefunc_t softCallback, plmtpressurefunc_t hardCallback, memptr_t data);
+int plMTSetSampling(plmt_t* mt, size_t sampleRate);
+void plMTSetSampleTag(plmt_t* mt, string_t tag);
+int plMTDumpSamples(plmt_t* mt, FILE* stream);
 
 memptr_t plMTAlloc(plmt_t* mt, size_t size);
 memptr_t plMTAllocE(plmt_t* mt, size_t size);
 memptr_t plMTCalloc(plmt_t* mt, size_t amount, size_t size);
 memptr_t plMTRealloc(plmt_t* mt, memptr_t pointer, size_t size);
+memptr_t plMTAllocAligned(plmt_t* mt, size_t size, size_t alignment);
+memptr_t plMTReallocAligned(plmt_t* mt, memptr_t pointer, size_t size, size_t alignment);
 void plMTFree(plmt_t* mt, memptr_t pointer);
+void plMTFreeMany(plmt_t* mt, memptr_t* pointers, size_t count);
+
+size_t plMTSizeOf(plmt_t* mt, memptr_t pointer);
+bool plMTIsShared(plmt_t* mt);
 
+size_t plMTArrayCapacity(plarray_t* array, size_t elementSize);
+int plMTArrayReserve(plarray_t* array, size_t elementSize, size_t capacity);
+int plMTArrayAppend(plarray_t* array, size_t elementSize, memptr_t elements, size_t amount);
+int plMTArrayPush(plarray_t* array, size_t elementSize, memptr_t element);
+int plMTArrayPop(plarray_t* array, size_t elementSize, memptr_t element);
+int plMTArrayShrink(plarray_t* array, size_t elementSize);
 void plMTFreeArray(plarray_t* array, bool is2DArray);
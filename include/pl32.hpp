@@ -7,6 +7,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 
 #define PL32CPP
 
@@ -43,6 +44,85 @@ namespace pl32 {
 						mt = pl32::cApi::plMTInit(maxMemoryAmnt);
 				}
 
+				void initArena(size_t chunkSize, size_t maxMemoryAmnt){
+					if(mt == NULL)
+						mt = pl32::cApi::plMTInitArena(chunkSize, maxMemoryAmnt);
+				}
+
+				void initShared(size_t maxMemoryAmnt){
+					if(mt == NULL)
+						mt = pl32::cApi::plMTInitShared(maxMemoryAmnt);
+				}
+
+				bool isShared(){
+					return pl32::cApi::plMTIsShared(mt);
+				}
+
+				void initChild(tracker &parent, size_t maxMemoryAmnt){
+					if(mt == NULL)
+						mt = pl32::cApi::plMTInitChild(parent.getMTHandle(), maxMemoryAmnt);
+				}
+
+				size_t getChildUsedSize(){
+					return pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_GET_CHILDMEM, 0);
+				}
+
+				size_t getPeakSize(){
+					return pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_GET_PEAKMEM, 0);
+				}
+
+				int setBackend(const pl32::cApi::plmtbackend_t* backend){
+					return pl32::cApi::plMTSetBackend(mt, backend);
+				}
+
+				size_t getSoftMaxSize(){
+					return pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_GET_SOFTMEM, 0);
+				}
+
+				void setSoftMaxSize(size_t newSoftMaxSize){
+					pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_SET_SOFTMEM, newSoftMaxSize);
+				}
+
+				int chargeExternal(size_t size){
+					return pl32::cApi::plMTChargeExternal(mt, size);
+				}
+
+				void unchargeExternal(size_t size){
+					pl32::cApi::plMTUnchargeExternal(mt, size);
+				}
+
+				void setPressureCallbacks(pl32::cApi::plmtpressurefunc_t softCallback, pl32::cApi::plmtpressurefunc_t hardCallback, pl32::cApi::memptr_t data){
+					pl32::cApi::plMTSetPressureCallbacks(mt, softCallback, hardCallback, data);
+				}
+
+				void setSampling(size_t sampleRate){
+					pl32::cApi::plMTSetSampling(mt, sampleRate);
+				}
+
+				void setSampleTag(pl32::cApi::string_t tag){
+					pl32::cApi::plMTSetSampleTag(mt, tag);
+				}
+
+				int dumpSamples(FILE* stream){
+					return pl32::cApi::plMTDumpSamples(mt, stream);
+				}
+
+				size_t getRetainSize(){
+					return pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_GET_RETAINMEM, 0);
+				}
+
+				void setRetainSize(size_t newRetainSize){
+					pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_SET_RETAINMEM, newRetainSize);
+				}
+
+				size_t getCachedSize(){
+					return pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_GET_CACHEDMEM, 0);
+				}
+
+				void reset(){
+					pl32::cApi::plMTReset(mt);
+				}
+
 				size_t getUsedSize(){
 					return pl32::cApi::plMTMemAmnt(mt, pl32::cApi::PLMT_GET_USEDMEM, 0);
 				}
@@ -67,10 +147,22 @@ namespace pl32 {
 					return pl32::cApi::plMTRealloc(mt, pointer, newSize);
 				}
 
+				pl32::cApi::memptr_t allocAligned(size_t size, size_t alignment){
+					return pl32::cApi::plMTAllocAligned(mt, size, alignment);
+				}
+
+				pl32::cApi::memptr_t reallocAligned(pl32::cApi::memptr_t pointer, size_t newSize, size_t alignment){
+					return pl32::cApi::plMTReallocAligned(mt, pointer, newSize, alignment);
+				}
+
 				void free(pl32::cApi::memptr_t pointer){
 					pl32::cApi::plMTFree(mt, pointer);
 				}
 
+				void freeMany(pl32::cApi::memptr_t* pointers, size_t count){
+					pl32::cApi::plMTFreeMany(mt, pointers, count);
+				}
+
 				pl32::cApi::plmt_t* getMTHandle(){
 					return mt;
 				}
@@ -89,6 +181,14 @@ namespace pl32 {
 					is2DArray = is2dimArray;
 				}
 
+				fatPointer(tracker &tracker){
+					fatPtr.array = NULL;
+					fatPtr.size = 0;
+					fatPtr.isMemAlloc = true;
+					fatPtr.mt = tracker.getMTHandle();
+					is2DArray = false;
+				}
+
 				fatPointer(pl32::cApi::memptr_t pointer, size_t size, bool is2dimArray){
 					fatPtr.array = pointer;
 					fatPtr.size = size;
@@ -114,6 +214,30 @@ namespace pl32 {
 					return fatPtr.isMemAlloc;
 				}
 
+				size_t getCapacity(size_t elementSize){
+					return pl32::cApi::plMTArrayCapacity(&fatPtr, elementSize);
+				}
+
+				int reserve(size_t elementSize, size_t capacity){
+					return pl32::cApi::plMTArrayReserve(&fatPtr, elementSize, capacity);
+				}
+
+				int append(size_t elementSize, pl32::cApi::memptr_t elements, size_t amount){
+					return pl32::cApi::plMTArrayAppend(&fatPtr, elementSize, elements, amount);
+				}
+
+				int push(size_t elementSize, pl32::cApi::memptr_t element){
+					return pl32::cApi::plMTArrayPush(&fatPtr, elementSize, element);
+				}
+
+				int pop(size_t elementSize, pl32::cApi::memptr_t element){
+					return pl32::cApi::plMTArrayPop(&fatPtr, elementSize, element);
+				}
+
+				int shrinkToFit(size_t elementSize){
+					return pl32::cApi::plMTArrayShrink(&fatPtr, elementSize);
+				}
+
 				const pl32::cApi::plfatptr_t* getFatPointerHandle(){
 					return &fatPtr;
 				}
@@ -158,5 +282,47 @@ namespace pl32 {
 			void write(memory::fatPointer data){
 				pl32::cApi::plFWrite(data.getPointer(), data.getSize(), 1, fileHandle);
 			}
+
+			memory::fatPointer peek(size_t amountOfBytes){
+				pl32::cApi::plarray_t view = pl32::cApi::plFPeek(fileHandle, amountOfBytes);
+
+				return memory::fatPointer(view.array, view.size, false);
+			}
+
+			memory::fatPointer view(){
+				pl32::cApi::plarray_t view = pl32::cApi::plFView(fileHandle);
+
+				return memory::fatPointer(view.array, view.size, false);
+			}
+
+			memory::fatPointer nextLine(){
+				pl32::cApi::plarray_t line = pl32::cApi::plFNextLine(fileHandle);
+
+				return memory::fatPointer(line.array, line.size, false);
+			}
+
+			int advance(size_t amountOfBytes){
+				return pl32::cApi::plFAdvance(fileHandle, amountOfBytes);
+			}
+
+			int reserve(size_t capacity){
+				return pl32::cApi::plFReserve(fileHandle, capacity);
+			}
+
+			int shrinkToFit(){
+				return pl32::cApi::plFShrink(fileHandle);
+			}
+
+			int setSpill(size_t spillSize){
+				return pl32::cApi::plFSetSpill(fileHandle, spillSize);
+			}
+
+			int advise(pl32::cApi::plfadvice_t advice){
+				return pl32::cApi::plFAdvise(fileHandle, advice);
+			}
+
+			int setReadahead(size_t windowSize){
+				return pl32::cApi::plFSetReadahead(fileHandle, windowSize);
+			}
 	};
 }
@@ -0,0 +1,545 @@
+/****************************************\
+* pl32-bench: pl32lib benchmarks         *
+* (c)2023 pocketlinux32, Under MPL v2.0  *
+\****************************************/
+#define _POSIX_C_SOURCE 200809L
+#include <pl32.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef struct mtbencharg {
+	plmt_t* mt;
+	pthread_mutex_t* lock;
+	pthread_barrier_t* barrier;
+	memptr_t* ownBlocks;
+	memptr_t* neighborBlocks;
+	size_t iterations;
+} mtbencharg_t;
+
+double getTime(){
+	struct timespec timeSpec;
+
+	clock_gettime(CLOCK_MONOTONIC, &timeSpec);
+	return timeSpec.tv_sec + timeSpec.tv_nsec / 1000000000.0;
+}
+
+/* Every thread allocates and frees its own blocks, keeping a window of 64 blocks alive */
+void* mtLocalThread(void* argPtr){
+	mtbencharg_t* arg = argPtr;
+	memptr_t window[64] = { NULL };
+
+	for(size_t i = 0; i < arg->iterations; i++){
+		if(arg->lock != NULL)
+			pthread_mutex_lock(arg->lock);
+
+		plMTFree(arg->mt, window[i % 64]);
+		window[i % 64] = plMTAllocE(arg->mt, (i * 37) % 256 + 8);
+
+		if(arg->lock != NULL)
+			pthread_mutex_unlock(arg->lock);
+	}
+
+	for(int i = 0; i < 64; i++){
+		if(arg->lock != NULL)
+			pthread_mutex_lock(arg->lock);
+
+		plMTFree(arg->mt, window[i]);
+
+		if(arg->lock != NULL)
+			pthread_mutex_unlock(arg->lock);
+	}
+
+	return NULL;
+}
+
+/* Every thread allocates a batch of blocks, then frees the batch of the next thread */
+void* mtCrossThread(void* argPtr){
+	mtbencharg_t* arg = argPtr;
+
+	for(size_t i = 0; i < arg->iterations; i += 256){
+		for(int j = 0; j < 256; j++)
+			arg->ownBlocks[j] = plMTAllocE(arg->mt, (j * 37) % 256 + 8);
+
+		pthread_barrier_wait(arg->barrier);
+		for(int j = 0; j < 256; j++)
+			plMTFree(arg->mt, arg->neighborBlocks[j]);
+
+		pthread_barrier_wait(arg->barrier);
+	}
+
+	return NULL;
+}
+
+/* Runs threadFunc on threadAmnt threads and returns the amount of million alloc/free pairs per second */
+double runMTBench(void* (*threadFunc)(void*), plmt_t* mt, pthread_mutex_t* lock, int threadAmnt, size_t iterations){
+	pthread_t* threads = malloc(threadAmnt * sizeof(pthread_t));
+	mtbencharg_t* args = malloc(threadAmnt * sizeof(mtbencharg_t));
+	memptr_t* blocks = malloc(threadAmnt * 256 * sizeof(memptr_t));
+	pthread_barrier_t barrier;
+
+	pthread_barrier_init(&barrier, NULL, threadAmnt);
+	for(int i = 0; i < threadAmnt; i++){
+		args[i].mt = mt;
+		args[i].lock = lock;
+		args[i].barrier = &barrier;
+		args[i].ownBlocks = blocks + i * 256;
+		args[i].neighborBlocks = blocks + ((i + 1) % threadAmnt) * 256;
+		args[i].iterations = iterations;
+	}
+
+	double startTime = getTime();
+	for(int i = 0; i < threadAmnt; i++)
+		pthread_create(&threads[i], NULL, threadFunc, &args[i]);
+
+	for(int i = 0; i < threadAmnt; i++)
+		pthread_join(threads[i], NULL);
+
+	double elapsedTime = getTime() - startTime;
+
+	pthread_barrier_destroy(&barrier);
+	free(blocks);
+	free(args);
+	free(threads);
+
+	return (threadAmnt * (double)iterations) / elapsedTime / 1000000.0;
+}
+
+int plMTScalingBench(int maxThreads, size_t iterations){
+	pthread_mutex_t lock;
+
+	pthread_mutex_init(&lock, NULL);
+	printf("Shared tracker alloc/free throughput (million pairs/s, %zu pairs per thread)\n\n", iterations);
+	printf("%-8s %-16s %-16s %-16s\n", "Threads", "Shared (local)", "Shared (cross)", "Mutex + plMTInit");
+
+	for(int threadAmnt = 1; threadAmnt <= maxThreads; threadAmnt++){
+		plmt_t* sharedMT = plMTInitShared(256 * 1024 * 1024);
+		double localRate = runMTBench(mtLocalThread, sharedMT, NULL, threadAmnt, iterations);
+		double crossRate = runMTBench(mtCrossThread, sharedMT, NULL, threadAmnt, iterations);
+		plMTStop(sharedMT);
+
+		plmt_t* lockedMT = plMTInit(256 * 1024 * 1024);
+		double lockedRate = runMTBench(mtLocalThread, lockedMT, &lock, threadAmnt, iterations);
+		plMTStop(lockedMT);
+
+		printf("%-8d %-16.2f %-16.2f %-16.2f\n", threadAmnt, localRate, crossRate, lockedRate);
+	}
+
+	pthread_mutex_destroy(&lock);
+	return 0;
+}
+
+/* Opens an empty stream of the given type, either a temporary file or a file in memory */
+plfile_t* openCatStream(bool isFile, plmt_t* mt){
+	if(isFile)
+		return plFToP(tmpfile(), "w+", mt);
+
+	return plFOpen(NULL, "w+", mt);
+}
+
+/* Copies sizeMiB MiB between every pair of stream types with plFCat, and with a byte at a time loop */
+int plFCatBench(size_t sizeMiB, int iterations){
+	string_t typeNames[2] = { "memory", "file" };
+	size_t dataSize = sizeMiB * 1024 * 1024;
+	plmt_t* mt = plMTInit(SIZE_MAX);
+	byte_t* data = plMTAllocE(mt, dataSize);
+
+	for(size_t i = 0; i < dataSize; i++)
+		data[i] = i * 31;
+
+	printf("plFCat throughput (GB/s, %zu MiB copied %d times)\n\n", sizeMiB, iterations);
+	printf("%-18s %-12s %-12s\n", "Source -> Dest", "plFCat", "Byte loop");
+
+	for(int srcType = 0; srcType < 2; srcType++){
+		plfile_t* src = openCatStream(srcType, mt);
+		plFWrite(data, 1, dataSize, src);
+
+		for(int destType = 0; destType < 2; destType++){
+			double catTime = 0;
+			double loopTime = 0;
+
+			for(int i = 0; i < iterations; i++){
+				plfile_t* dest = openCatStream(destType, mt);
+				double startTime = getTime();
+				size_t copiedSize = plFCat(dest, src, SEEK_SET, SEEK_SET, false);
+				plFFlush(dest);
+				catTime += getTime() - startTime;
+				plFClose(dest);
+
+				if(copiedSize != dataSize){
+					printf("plFCat only copied %zu out of %zu bytes\n", copiedSize, dataSize);
+					return 1;
+				}
+
+				dest = openCatStream(destType, mt);
+				plFSeek(src, 0, SEEK_SET);
+				startTime = getTime();
+				int ch;
+				while((ch = plFGetC(src)) != EOF)
+					plFPutC(ch, dest);
+				plFFlush(dest);
+				loopTime += getTime() - startTime;
+				plFClose(dest);
+			}
+
+			char pairName[32];
+			snprintf(pairName, sizeof(pairName), "%s -> %s", typeNames[srcType], typeNames[destType]);
+			printf("%-18s %-12.2f %-12.2f\n", pairName, (double)dataSize * iterations / catTime / 1e9, (double)dataSize * iterations / loopTime / 1e9);
+		}
+
+		plFClose(src);
+	}
+
+	plMTStop(mt);
+	return 0;
+}
+
+/* Reads the file at path in 1 MiB chunks, spending some work on every chunk. advice and readaheadSize *\
+\* are applied before reading, and isCold evicts the file from the page cache first. Returns MB/s     */
+double runAdviseBench(string_t path, plfadvice_t advice, size_t readaheadSize, bool isCold, plmt_t* mt){
+	plfile_t* file = plFOpen(path, "r", mt);
+	byte_t* chunk = plMTAllocE(mt, 1024 * 1024);
+	size_t totalSize = 0;
+	size_t readSize;
+	uint32_t checksum = 0;
+
+	if(isCold)
+		plFAdvise(file, PLF_ADVISE_DONTNEED);
+
+	plFAdvise(file, advice);
+	if(readaheadSize != 0)
+		plFSetReadahead(file, readaheadSize);
+
+	double startTime = getTime();
+	while((readSize = plFRead(chunk, 1, 1024 * 1024, file)) != 0){
+		for(size_t i = 0; i < readSize; i++)
+			checksum = (checksum ^ chunk[i]) * 16777619;
+
+		totalSize += readSize;
+	}
+	double elapsedTime = getTime() - startTime;
+
+	if(checksum == 1)
+		printf("(checksum collision)\n");
+
+	plMTFree(mt, chunk);
+	plFClose(file);
+	return totalSize / elapsedTime / 1e6;
+}
+
+/* Compares cold-cache sequential reads without hints, with PLF_ADVISE_SEQUENTIAL and with background readahead */
+int plFAdviseBench(size_t sizeMiB, string_t path){
+	plmt_t* mt = plMTInit(SIZE_MAX);
+	plfile_t* file = plFOpen(path, "w", mt);
+	byte_t* chunk = plMTAllocE(mt, 1024 * 1024);
+
+	if(file == NULL){
+		printf("Could not create %s\n", path);
+		return 1;
+	}
+
+	for(size_t i = 0; i < 1024 * 1024; i++)
+		chunk[i] = i * 31;
+	for(size_t i = 0; i < sizeMiB; i++)
+		plFWrite(chunk, 1, 1024 * 1024, file);
+
+	plFFlush(file);
+	plFClose(file);
+
+	/* Dirty pages can't be evicted, so they have to reach the disk first */
+	int fd = open(path, O_RDONLY);
+	fdatasync(fd);
+	close(fd);
+
+	printf("Cold-cache sequential read throughput (MB/s, %zu MiB file at %s)\n\n", sizeMiB, path);
+	printf("%-28s %-12s\n", "Hints", "Throughput");
+	printf("%-28s %-12.2f\n", "None", runAdviseBench(path, PLF_ADVISE_NORMAL, 0, true, mt));
+	printf("%-28s %-12.2f\n", "Sequential", runAdviseBench(path, PLF_ADVISE_SEQUENTIAL, 0, true, mt));
+	printf("%-28s %-12.2f\n", "Sequential + 16 MiB ahead", runAdviseBench(path, PLF_ADVISE_SEQUENTIAL, 16 * 1024 * 1024, true, mt));
+	printf("%-28s %-12.2f\n", "Already cached (limit)", runAdviseBench(path, PLF_ADVISE_NORMAL, 0, false, mt));
+
+	unlink(path);
+	plMTFree(mt, chunk);
+	plMTStop(mt);
+	return 0;
+}
+
+/* File in memory shared between threads behind a mutex, which is how a pipe is done without plFPipe */
+typedef struct lockedstream {
+	plfile_t* file;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t writtenSize;
+	size_t readSize;
+	bool isClosed;
+} lockedstream_t;
+
+/* One side of the pipe benchmark, either a pair of pipe ends or a pair of locked streams */
+typedef struct pipebencharg {
+	plfile_t* pipeIn;
+	plfile_t* pipeOut;
+	lockedstream_t* lockedIn;
+	lockedstream_t* lockedOut;
+	size_t lineAmnt;
+} pipebencharg_t;
+
+void lockedInit(lockedstream_t* stream, plmt_t* mt){
+	stream->file = plFOpen(NULL, "w+", mt);
+	pthread_mutex_init(&stream->lock, NULL);
+	pthread_cond_init(&stream->cond, NULL);
+	stream->writtenSize = 0;
+	stream->readSize = 0;
+	stream->isClosed = false;
+}
+
+void lockedStop(lockedstream_t* stream){
+	plFClose(stream->file);
+	pthread_cond_destroy(&stream->cond);
+	pthread_mutex_destroy(&stream->lock);
+}
+
+void lockedWrite(lockedstream_t* stream, string_t line){
+	pthread_mutex_lock(&stream->lock);
+	plFSeek(stream->file, 0, SEEK_END);
+	plFPuts(line, stream->file);
+	stream->writtenSize = plFTell(stream->file);
+	pthread_cond_signal(&stream->cond);
+	pthread_mutex_unlock(&stream->lock);
+}
+
+void lockedClose(lockedstream_t* stream){
+	pthread_mutex_lock(&stream->lock);
+	stream->isClosed = true;
+	pthread_cond_signal(&stream->cond);
+	pthread_mutex_unlock(&stream->lock);
+}
+
+/* Reads the next line, waiting for one if there isn't any yet. Returns false once the stream is closed */
+bool lockedRead(lockedstream_t* stream, string_t line, int size){
+	bool isRead = false;
+
+	pthread_mutex_lock(&stream->lock);
+	while(stream->readSize == stream->writtenSize && !stream->isClosed)
+		pthread_cond_wait(&stream->cond, &stream->lock);
+
+	if(stream->readSize != stream->writtenSize){
+		plFSeek(stream->file, stream->readSize, SEEK_SET);
+		isRead = plFGets(line, size, stream->file) != NULL;
+		stream->readSize = plFTell(stream->file);
+	}
+	pthread_mutex_unlock(&stream->lock);
+
+	return isRead;
+}
+
+/* Writes lineAmnt lines of 64 bytes, then closes the stream */
+void* pipeProducerThread(void* argPtr){
+	pipebencharg_t* arg = argPtr;
+	char line[65];
+
+	memset(line, 'x', 63);
+	line[63] = '\n';
+	line[64] = '\0';
+
+	for(size_t i = 0; i < arg->lineAmnt; i++){
+		line[i % 63] = 'a' + i % 26;
+		if(arg->pipeOut != NULL)
+			plFPuts(line, arg->pipeOut);
+		else
+			lockedWrite(arg->lockedOut, line);
+	}
+
+	if(arg->pipeOut != NULL)
+		plFClose(arg->pipeOut);
+	else
+		lockedClose(arg->lockedOut);
+
+	return NULL;
+}
+
+/* Sends every line it gets back, until the stream is closed */
+void* pipeEchoThread(void* argPtr){
+	pipebencharg_t* arg = argPtr;
+	char line[256];
+
+	if(arg->pipeIn != NULL){
+		while(plFGets(line, 256, arg->pipeIn) != NULL)
+			plFPuts(line, arg->pipeOut);
+	}else{
+		while(lockedRead(arg->lockedIn, line, 256))
+			lockedWrite(arg->lockedOut, line);
+	}
+
+	return NULL;
+}
+
+/* Passes lineAmnt lines from a producer thread to this one and returns MB/s. Then bounces *\
+\* a line off an echo thread roundTrips times and stores the average round trip in *latency */
+double runPipeBench(bool isPipe, size_t lineAmnt, size_t roundTrips, double* latency, plmt_t* mt){
+	pipebencharg_t arg = { NULL, NULL, NULL, NULL, lineAmnt };
+	plfile_t* ends[2][2];
+	lockedstream_t locked[2];
+	pthread_t thread;
+	char line[256];
+	size_t readSize = 0;
+
+	if(isPipe){
+		plFPipe(ends[0], 1024 * 1024, true, mt);
+		arg.pipeOut = ends[0][1];
+	}else{
+		lockedInit(&locked[0], mt);
+		arg.lockedOut = &locked[0];
+	}
+
+	double startTime = getTime();
+	pthread_create(&thread, NULL, pipeProducerThread, &arg);
+	if(isPipe){
+		while(plFGets(line, 256, ends[0][0]) != NULL)
+			readSize += strlen(line);
+	}else{
+		while(lockedRead(&locked[0], line, 256))
+			readSize += strlen(line);
+	}
+	pthread_join(thread, NULL);
+	double elapsedTime = getTime() - startTime;
+
+	if(isPipe)
+		plFClose(ends[0][0]);
+	else
+		lockedStop(&locked[0]);
+
+	/* Every line is committed as soon as it's written, so it goes out right away */
+	if(isPipe){
+		plFPipe(ends[0], 4096, true, mt);
+		plFPipe(ends[1], 4096, true, mt);
+		plFSetBuf(ends[0][1], 0, PLF_FLUSH_LINE);
+		plFSetBuf(ends[1][1], 0, PLF_FLUSH_LINE);
+		arg.pipeIn = ends[0][0];
+		arg.pipeOut = ends[1][1];
+	}else{
+		lockedInit(&locked[0], mt);
+		lockedInit(&locked[1], mt);
+		arg.lockedIn = &locked[0];
+		arg.lockedOut = &locked[1];
+	}
+
+	pthread_create(&thread, NULL, pipeEchoThread, &arg);
+	double roundTripStart = getTime();
+	for(size_t i = 0; i < roundTrips; i++){
+		if(isPipe){
+			plFPuts("ping\n", ends[0][1]);
+			plFGets(line, 256, ends[1][0]);
+		}else{
+			lockedWrite(&locked[0], "ping\n");
+			lockedRead(&locked[1], line, 256);
+		}
+	}
+	*latency = (getTime() - roundTripStart) / roundTrips * 1e6;
+
+	if(isPipe){
+		plFClose(ends[0][1]);
+		pthread_join(thread, NULL);
+		plFClose(ends[0][0]);
+		plFClose(ends[1][1]);
+		plFClose(ends[1][0]);
+	}else{
+		lockedClose(&locked[0]);
+		pthread_join(thread, NULL);
+		lockedStop(&locked[0]);
+		lockedStop(&locked[1]);
+	}
+
+	return readSize / elapsedTime / 1e6;
+}
+
+/* Compares plFPipe to a file in memory behind a mutex, passing lines of 64 bytes between two threads */
+int plFPipeBench(size_t sizeMiB, size_t roundTrips){
+	plmt_t* mt = plMTInitShared(SIZE_MAX);
+	size_t lineAmnt = sizeMiB * 1024 * 1024 / 64;
+	double pipeLatency;
+	double lockedLatency;
+	double pipeRate = runPipeBench(true, lineAmnt, roundTrips, &pipeLatency, mt);
+	double lockedRate = runPipeBench(false, lineAmnt, roundTrips, &lockedLatency, mt);
+
+	printf("Line passing between threads (%zu MiB of 64 byte lines, %zu round trips)\n\n", sizeMiB, roundTrips);
+	printf("%-24s %-18s %-18s\n", "Stream", "Throughput (MB/s)", "Round trip (us)");
+	printf("%-24s %-18.2f %-18.2f\n", "plFPipe", pipeRate, pipeLatency);
+	printf("%-24s %-18.2f %-18.2f\n", "Mutex + file in memory", lockedRate, lockedLatency);
+
+	plMTStop(mt);
+	return 0;
+}
+
+int main(int argc, string_t argv[]){
+	if(argc < 2){
+		printf("Valid benchmarks:\n mt-scaling [max threads] [iterations]\n file-cat [size in MiB] [iterations]\n file-advise [size in MiB] [path]\n file-pipe [size in MiB] [round trips]\n");
+		return 1;
+	}
+
+	if(strcmp(argv[1], "mt-scaling") == 0){
+		int maxThreads = 8;
+		size_t iterations = 1000000;
+
+		if(argc > 2)
+			maxThreads = atoi(argv[2]);
+		if(argc > 3)
+			iterations = strtoul(argv[3], NULL, 10);
+
+		if(maxThreads < 1)
+			maxThreads = 1;
+
+		return plMTScalingBench(maxThreads, iterations);
+	}
+
+	if(strcmp(argv[1], "file-cat") == 0){
+		size_t sizeMiB = 64;
+		int iterations = 5;
+
+		if(argc > 2)
+			sizeMiB = strtoul(argv[2], NULL, 10);
+		if(argc > 3)
+			iterations = atoi(argv[3]);
+
+		if(sizeMiB < 1)
+			sizeMiB = 1;
+		if(iterations < 1)
+			iterations = 1;
+
+		return plFCatBench(sizeMiB, iterations);
+	}
+
+	if(strcmp(argv[1], "file-advise") == 0){
+		size_t sizeMiB = 256;
+		string_t path = "pl32-bench-advise.tmp";
+
+		if(argc > 2)
+			sizeMiB = strtoul(argv[2], NULL, 10);
+		if(argc > 3)
+			path = argv[3];
+
+		if(sizeMiB < 1)
+			sizeMiB = 1;
+
+		return plFAdviseBench(sizeMiB, path);
+	}
+
+	if(strcmp(argv[1], "file-pipe") == 0){
+		size_t sizeMiB = 256;
+		size_t roundTrips = 100000;
+
+		if(argc > 2)
+			sizeMiB = strtoul(argv[2], NULL, 10);
+		if(argc > 3)
+			roundTrips = strtoul(argv[3], NULL, 10);
+
+		if(sizeMiB < 1)
+			sizeMiB = 1;
+		if(roundTrips < 1)
+			roundTrips = 1;
+
+		return plFPipeBench(sizeMiB, roundTrips);
+	}
+
+	return 1;
+}
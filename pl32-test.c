@@ -2,7 +2,10 @@
 * pl32-test: pl32lib testcase            *
 * (c)2022 pocketlinux32, Under MPL v2.0  *
 \****************************************/
+#define _POSIX_C_SOURCE 200112L
 #include <pl32.h>
+#include <pthread.h>
+#include <unistd.h>
 
 bool nonInteractive = false;
 
@@ -44,6 +47,70 @@ int testLoop(string_t strToTokenize, plmt_t* mt){
 	return 0;
 }
 
+memptr_t pressureCache = NULL;
+plmt_t* pressureLimitMT = NULL;
+int softPressureAmnt = 0;
+bool isPressureValid = true;
+
+/* Both callbacks have to get the tracker with the limits and the size of the allocation that reached them */
+void softPressureTest(plmt_t* mt, size_t size, memptr_t data){
+	(void)data;
+	isPressureValid = isPressureValid && mt == pressureLimitMT && size == 3000;
+	softPressureAmnt++;
+}
+
+/* Drops the cache block, so the allocation that hit the hard limit can go through */
+void hardPressureTest(plmt_t* mt, size_t size, memptr_t data){
+	isPressureValid = isPressureValid && mt == pressureLimitMT && size == 2000;
+	plMTFree(data, pressureCache);
+	pressureCache = NULL;
+}
+
+typedef struct sharedtestarg {
+	plmt_t* mt;
+	memptr_t* ownBlocks;
+	memptr_t* neighborBlocks;
+	pthread_barrier_t* barrier;
+} sharedtestarg_t;
+
+void* sharedTestThread(void* argPtr){
+	sharedtestarg_t* arg = argPtr;
+
+	for(int i = 0; i < 1000; i++)
+		arg->ownBlocks[i] = plMTAllocE(arg->mt, (i % 300) + 1);
+
+	/* Free the blocks another thread allocated, so they have to go through its return queue */
+	pthread_barrier_wait(arg->barrier);
+	for(int i = 0; i < 1000; i++)
+		plMTFree(arg->mt, arg->neighborBlocks[i]);
+
+	pthread_barrier_wait(arg->barrier);
+	return NULL;
+}
+
+/* Writes numbered lines into the write end of a pipe, then closes it */
+void* pipeTestThread(void* argPtr){
+	plfile_t* writeEnd = argPtr;
+	char line[64];
+
+	for(int i = 0; i < 20000; i++){
+		snprintf(line, 64, "Piped line %d\n", i);
+		plFPuts(line, writeEnd);
+	}
+
+	plFClose(writeEnd);
+	return NULL;
+}
+
+/* Frees the same block as another thread at the same time */
+void* doubleFreeThread(void* argPtr){
+	sharedtestarg_t* arg = argPtr;
+
+	pthread_barrier_wait(arg->barrier);
+	plMTFree(arg->mt, arg->ownBlocks[0]);
+	return NULL;
+}
+
 int plMemoryTest(plmt_t* mt){
 	printCurrentMemUsg(mt);
 
@@ -95,6 +162,335 @@ int plMemoryTest(plmt_t* mt){
 	printf("Done\n");
 	printCurrentMemUsg(mt);
 
+	printf("Stress-testing pointer tracking (10000 pointers)...");
+
+	memptr_t* ptrArray = plMTAllocE(mt, sizeof(memptr_t) * 10000);
+	size_t baseUsage = plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0);
+	for(int i = 0; i < 10000; i++)
+		ptrArray[i] = plMTAllocE(mt, (i % 64) + 1);
+
+	for(int i = 0; i < 10000; i += 2)
+		plMTFree(mt, ptrArray[i]);
+
+	for(int i = 1; i < 10000; i += 2)
+		ptrArray[i] = plMTRealloc(mt, ptrArray[i], 128);
+
+	for(int i = 9999; i > 0; i -= 2)
+		plMTFree(mt, ptrArray[i]);
+
+	if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != baseUsage){
+		printf("Error!\nMemory usage mismatch after freeing all pointers\n");
+		return 1;
+	}
+
+	printf("Done\n");
+	printf("Freeing a batch of pointers at once...");
+
+	for(int i = 0; i < 10000; i++)
+		ptrArray[i] = plMTAllocE(mt, (i % 300) + 1);
+
+	ptrArray[5000] = NULL;
+	plMTFreeMany(mt, ptrArray, 10000);
+	if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != baseUsage + 5000 % 300 + 1){
+		printf("Error!\nBatch free did not free every tracked pointer\n");
+		return 1;
+	}
+
+	plMTReset(mt);
+	printf("Done\n");
+	printCurrentMemUsg(mt);
+
+	printf("Testing custom slab size classes...");
+
+	size_t sizeClasses[3] = { 24, 8, 40 };
+	if(plMTSetSizeClasses(mt, sizeClasses, 3)){
+		printf("Error!\nCouldn't set size classes on an empty tracker\n");
+		return 1;
+	}
+
+	string_t slabStr = plMTAllocE(mt, 7);
+	strcpy(slabStr, "slabby");
+	slabStr = plMTRealloc(mt, slabStr, 40);
+	if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != 40 || strcmp(slabStr, "slabby") != 0 || plMTSetSizeClasses(mt, NULL, 0) == 0){
+		printf("Error!\nSlab block was not tracked properly\n");
+		return 1;
+	}
+
+	slabStr = plMTRealloc(mt, slabStr, 2000);
+	if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != 2000 || strcmp(slabStr, "slabby") != 0){
+		printf("Error!\nSlab block was not moved to malloc properly\n");
+		return 1;
+	}
+
+	plMTFree(mt, slabStr);
+	printf("Done\n");
+	printCurrentMemUsg(mt);
+
+	printf("Allocating aligned blocks...");
+
+	plmt_t* alignedArenaMT = plMTInitArena(0, 0);
+	byte_t* alignedBlock = plMTAllocAligned(mt, 100, 64);
+	memset(alignedBlock, 'a', 100);
+	alignedBlock = plMTReallocAligned(mt, alignedBlock, 5000, 4096);
+	plMTAllocE(alignedArenaMT, 10);
+	memptr_t arenaAlignedBlock = plMTAllocAligned(alignedArenaMT, 10, 256);
+	if((uintptr_t)alignedBlock % 4096 != 0 || alignedBlock[99] != 'a' || plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != 5000 || (uintptr_t)arenaAlignedBlock % 256 != 0){
+		printf("Error!\nAligned block was not aligned or accounted properly\n");
+		return 1;
+	}
+
+	plMTFree(mt, alignedBlock);
+	plMTStop(alignedArenaMT);
+	printf("Done\n");
+
+	printf("Growing a block with the mmap backend...");
+
+	plmt_t* mmapMT = plMTInit(0);
+	plMTSetBackend(mmapMT, &plMTMmapBackend);
+	byte_t* mmapBlock = plMTAllocE(mmapMT, 100 * 1024);
+
+	for(size_t i = 200 * 1024; i <= 8 * 1024 * 1024; i *= 2){
+		mmapBlock[i / 2 - 1] = 'm';
+		mmapBlock = plMTRealloc(mmapMT, mmapBlock, i);
+		if(mmapBlock == NULL || mmapBlock[i / 2 - 1] != 'm' || plMTMemAmnt(mmapMT, PLMT_GET_USEDMEM, 0) != i){
+			printf("Error!\nBlock was not resized properly by the mmap backend\n");
+			return 1;
+		}
+	}
+
+	/* The backend can't be changed while the tracker has memory allocated */
+	bool isBackendSet = plMTSetBackend(mmapMT, &plMTHugeTLBBackend) == 0;
+	plMTFree(mmapMT, mmapBlock);
+	if(plMTMemAmnt(mmapMT, PLMT_GET_USEDMEM, 0) != 0 || isBackendSet){
+		printf("Error!\nBackend memory was not accounted properly\n");
+		return 1;
+	}
+
+	plMTStop(mmapMT);
+	printf("Done\n");
+
+	printf("Shedding memory through pressure callbacks...");
+
+	plmt_t* pressureMT = plMTInit(4096);
+	plmt_t* pressureChildMT = plMTInitChild(pressureMT, 0);
+	pressureLimitMT = pressureMT;
+	plMTSetPressureCallbacks(pressureMT, softPressureTest, hardPressureTest, pressureChildMT);
+	plMTMemAmnt(pressureMT, PLMT_SET_SOFTMEM, 2048);
+
+	pressureCache = plMTAllocE(pressureChildMT, 3000);
+	memptr_t pressureBlock = plMTAlloc(pressureChildMT, 2000);
+	if(pressureBlock == NULL || pressureCache != NULL || softPressureAmnt != 1 || !isPressureValid || plMTMemAmnt(pressureMT, PLMT_GET_PRESSUREAMNT, 0) != 2 || plMTMemAmnt(pressureMT, PLMT_GET_SOFTMEM, 0) != 2048){
+		printf("Error!\nPressure callbacks were not called properly\n");
+		return 1;
+	}
+
+	plMTStop(pressureMT);
+	printf("Done\n");
+
+	printf("Growing an array one element at a time...");
+
+	plarray_t intVector = { NULL, 0, false, mt };
+	int extraInts[24];
+	int poppedInt = 0;
+
+	for(int i = 0; i < 1000; i++)
+		plMTArrayPush(&intVector, sizeof(int), &i);
+
+	for(int i = 0; i < 24; i++)
+		extraInts[i] = i;
+
+	plMTArrayAppend(&intVector, sizeof(int), extraInts, 24);
+	plMTArrayPop(&intVector, sizeof(int), &poppedInt);
+	if(intVector.size != 1023 || poppedInt != 23 || ((int*)intVector.array)[999] != 999 || plMTArrayCapacity(&intVector, sizeof(int)) != 1024){
+		printf("Error!\nArray elements or capacity are wrong\n");
+		return 1;
+	}
+
+	plMTArrayShrink(&intVector, sizeof(int));
+	if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != 1023 * sizeof(int)){
+		printf("Error!\nArray was not shrunk to fit\n");
+		return 1;
+	}
+
+	plMTFreeArray(&intVector, false);
+	printf("Done\n");
+
+	printf("Allocating and freeing across threads with a shared tracker...");
+
+	plmt_t* sharedMT = plMTInitShared(4 * 1024 * 1024);
+	pthread_t threads[4];
+	pthread_barrier_t barrier;
+	sharedtestarg_t threadArgs[4];
+	memptr_t threadBlocks[4][1000];
+
+	pthread_barrier_init(&barrier, NULL, 4);
+	for(int i = 0; i < 4; i++){
+		threadArgs[i].mt = sharedMT;
+		threadArgs[i].ownBlocks = threadBlocks[i];
+		threadArgs[i].neighborBlocks = threadBlocks[(i + 1) % 4];
+		threadArgs[i].barrier = &barrier;
+		pthread_create(&threads[i], NULL, sharedTestThread, &threadArgs[i]);
+	}
+
+	for(int i = 0; i < 4; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_barrier_destroy(&barrier);
+
+	/* Every thread drains the blocks handed back to its heap when it exits */
+	if(plMTMemAmnt(sharedMT, PLMT_GET_USEDMEM, 0) != 0){
+		printf("Error!\nShared tracker is not empty after freeing every block\n");
+		return 1;
+	}
+
+	/* Only one of the frees counts, and the other one gets ignored */
+	memptr_t doubleFreed = plMTAllocE(sharedMT, 64);
+	pthread_barrier_init(&barrier, NULL, 2);
+	for(int i = 0; i < 2; i++){
+		threadArgs[i].ownBlocks = &doubleFreed;
+		pthread_create(&threads[i], NULL, doubleFreeThread, &threadArgs[i]);
+	}
+
+	for(int i = 0; i < 2; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_barrier_destroy(&barrier);
+	plMTFree(sharedMT, plMTAllocE(sharedMT, 64));
+	if(plMTMemAmnt(sharedMT, PLMT_GET_USEDMEM, 0) != 0){
+		printf("Error!\nBlock freed twice from two threads was not handled properly\n");
+		return 1;
+	}
+
+	plMTStop(sharedMT);
+	printf("Done\n");
+
+	printf("Charging child trackers to a parent tracker...");
+
+	plmt_t* parentMT = plMTInit(4096);
+	plmt_t* fileMT = plMTInitChild(parentMT, 3072);
+	plmt_t* tokenMT = plMTInitChild(parentMT, 3072);
+
+	memptr_t parentBlock = plMTAllocE(parentMT, 512);
+	memptr_t fileBlock = plMTAllocE(fileMT, 2048);
+	memptr_t tokenBlock = plMTAlloc(tokenMT, 2048);
+
+	/* The token tracker is under its own limit, but the parent tracker is out of memory */
+	if(tokenBlock != NULL || plMTAlloc(fileMT, 2048) != NULL || plMTMemAmnt(parentMT, PLMT_GET_USEDMEM, 0) != 2560){
+		printf("Error!\nChild tracker went over its limit\n");
+		return 1;
+	}
+
+	tokenBlock = plMTAllocE(tokenMT, 1024);
+	if(plMTMemAmnt(parentMT, PLMT_GET_CHILDMEM, 0) != 3072 || plMTMemAmnt(parentMT, PLMT_GET_CHILDAMNT, 0) != 2){
+		printf("Error!\nChild tracker usage is not reflected in the parent tracker\n");
+		return 1;
+	}
+
+	plMTFree(fileMT, fileBlock);
+	plMTStop(tokenMT);
+	if(plMTMemAmnt(parentMT, PLMT_GET_USEDMEM, 0) != 512 || plMTMemAmnt(parentMT, PLMT_GET_CHILDAMNT, 0) != 1){
+		printf("Error!\nChild tracker memory was not given back to the parent tracker\n");
+		return 1;
+	}
+
+	plMTFree(parentMT, parentBlock);
+	plMTStop(parentMT);
+	printf("Done\n");
+
+	printf("Parsing into an arena memory tracker...");
+
+	plmt_t* arenaMT = plMTInitArena(4096, 1024 * 1024);
+	plarray_t* parsedArgs = plParser("arena \"allocated tokens\" in one chunk", arenaMT);
+	string_t lastToken = plMTAllocE(arenaMT, 64);
+	size_t arenaUsage = plMTMemAmnt(arenaMT, PLMT_GET_USEDMEM, 0);
+
+	plMTFree(arenaMT, lastToken);
+	if(parsedArgs->size != 5 || plMTMemAmnt(arenaMT, PLMT_GET_USEDMEM, 0) != arenaUsage - 64){
+		printf("Error!\nArena tracker did not reclaim its latest allocation\n");
+		return 1;
+	}
+
+	string_t movedToken = plMTAllocE(arenaMT, 64);
+	strcpy(movedToken, "moved");
+	movedToken = plMTRealloc(arenaMT, movedToken, 8192);
+	if(movedToken == NULL || strcmp(movedToken, "moved") != 0 || plMTMemAmnt(arenaMT, PLMT_GET_USEDMEM, 0) != arenaUsage - 64 + 8192){
+		printf("Error!\nArena tracker kept charging a moved latest allocation\n");
+		return 1;
+	}
+
+	plMTReset(arenaMT);
+	if(plMTMemAmnt(arenaMT, PLMT_GET_USEDMEM, 0) != 0){
+		printf("Error!\nArena tracker is not empty after a reset\n");
+		return 1;
+	}
+
+	plMTStop(arenaMT);
+	printf("Done\n");
+
+	printf("Reusing retained blocks after a reset...");
+
+	plmt_t* retainMT = plMTInit(0);
+	plMTMemAmnt(retainMT, PLMT_SET_RETAINMEM, 64 * 1024);
+	memptr_t retainedBlock = plMTAllocE(retainMT, 4000);
+
+	plMTReset(retainMT);
+	if(plMTMemAmnt(retainMT, PLMT_GET_CACHEDMEM, 0) != 4000 || plMTMemAmnt(retainMT, PLMT_GET_USEDMEM, 0) != 0){
+		printf("Error!\nReset did not retain the freed block\n");
+		return 1;
+	}
+
+	if(plMTAllocE(retainMT, 3000) != retainedBlock || plMTMemAmnt(retainMT, PLMT_GET_CACHEDMEM, 0) != 0 || plMTMemAmnt(retainMT, PLMT_GET_USEDMEM, 0) != 3000){
+		printf("Error!\nRetained block was not reused\n");
+		return 1;
+	}
+
+	plMTStop(retainMT);
+	printf("Done\n");
+
+	printf("Collecting allocation statistics...");
+
+	plmt_t* statsMT = plMTInit(1024);
+	plmtstats_t stats;
+	memptr_t statsBlock = plMTAllocE(statsMT, 100);
+
+	statsBlock = plMTRealloc(statsMT, statsBlock, 600);
+	plMTAlloc(statsMT, 2048);
+	plMTFree(statsMT, statsBlock);
+	if(plMTGetStats(statsMT, &stats) == 0 && (stats.allocAmnt != 1 || stats.reallocAmnt != 1 || stats.freeAmnt != 1 || stats.failAmnt != 1 || stats.liveAmnt != 0 || stats.peakMemory != 600)){
+		printf("Error!\nAllocation statistics do not match the allocations made\n");
+		return 1;
+	}
+
+	plMTStop(statsMT);
+	printf("Done\n");
+
+	printf("Sampling allocations by call site...");
+
+	plmt_t* sampleMT = plMTInit(0);
+	memptr_t sampledBlocks[4];
+	char sampleDump[4096] = "";
+	FILE* sampleFile = tmpfile();
+
+	plMTSetSampling(sampleMT, 1);
+	plMTSetSampleTag(sampleMT, "sample-test");
+	for(int i = 0; i < 4; i++)
+		sampledBlocks[i] = plMTAllocE(sampleMT, 64);
+
+	plMTFree(sampleMT, sampledBlocks[0]);
+	plMTDumpSamples(sampleMT, sampleFile);
+	rewind(sampleFile);
+	fread(sampleDump, 1, sizeof(sampleDump) - 1, sampleFile);
+	fclose(sampleFile);
+
+	/* Every block comes from the same call site, so they get folded into a single line */
+	if(strncmp(sampleDump, "sample-test;", 12) != 0 || strstr(sampleDump, " 192\n") == NULL || strchr(sampleDump, '\n') != sampleDump + strlen(sampleDump) - 1){
+		printf("Error!\nSampled allocations were not dumped properly\n");
+		return 1;
+	}
+
+	plMTStop(sampleMT);
+	printf("Done\n");
+
 	return 0;
 }
 
@@ -133,9 +529,429 @@ int plFileTest(string_t customFile, plmt_t* mt){
 			stringBuffer[i] = 0;
 	}
 
+	printf("\n");
 	plFClose(realFile);
 	plFClose(memFile);
 
+	printf("Writing and reading back through a small buffer...");
+	plfile_t* bufFile = plFToP(tmpfile(), "w+", mt);
+
+	/* A 7 byte buffer makes most calls refill or flush */
+	plFSetBuf(bufFile, 7, PLF_FLUSH_FULL);
+	for(int i = 0; i < 1000; i++)
+		plFPutC(i % 251, bufFile);
+	plFPuts("a line longer than the buffer\nshort\n", bufFile);
+	plFSeek(bufFile, 0, SEEK_SET);
+
+	for(int i = 0; i < 1000; i++){
+		if(plFGetC(bufFile) != i % 251){
+			printf("Error!\nByte %d was not read back properly\n", i);
+			return 1;
+		}
+	}
+
+	if(plFGets(stringBuffer, 4095, bufFile) == NULL || strcmp(stringBuffer, "a line longer than the buffer\n") != 0 || plFGets(stringBuffer, 4095, bufFile) == NULL || strcmp(stringBuffer, "short\n") != 0 || plFGetC(bufFile) != EOF || plFTell(bufFile) != 1036){
+		printf("Error!\nLines were not read back properly\n");
+		return 1;
+	}
+
+	plFClose(bufFile);
+	printf("Done\n");
+
+	printf("Viewing streams without copying...");
+	plfile_t* viewMemFile = plFOpen(NULL, "w+", mt);
+	plfile_t* viewBufFile = plFToP(tmpfile(), "w+", mt);
+
+	plFPuts("hello world", viewMemFile);
+	plFPuts("0123456789abcdefghij", viewBufFile);
+	plFSeek(viewMemFile, 0, SEEK_SET);
+	plFSeek(viewBufFile, 0, SEEK_SET);
+	plFSetBuf(viewBufFile, 8, PLF_FLUSH_FULL);
+
+	plarray_t memView = plFView(viewMemFile);
+	bool isViewValid = memView.size == 11 && !memView.isMemAlloc && plFAdvance(viewMemFile, 6) == 0 && plFAdvance(viewMemFile, 6) != 0;
+	memView = plFPeek(viewMemFile, 10);
+	isViewValid = isViewValid && memView.size == 5 && memcmp(memView.array, "world", 5) == 0;
+
+	/* The second peek has to move the unread bytes of the 8 byte buffer and read in behind them */
+	plarray_t bufView = plFPeek(viewBufFile, 6);
+	isViewValid = isViewValid && bufView.size == 6 && memcmp(bufView.array, "012345", 6) == 0 && plFAdvance(viewBufFile, 4) == 0;
+	bufView = plFPeek(viewBufFile, 8);
+	isViewValid = isViewValid && bufView.size == 8 && memcmp(bufView.array, "456789ab", 8) == 0 && plFAdvance(viewBufFile, 8) == 0 && plFGetC(viewBufFile) == 'c';
+	if(!isViewValid){
+		printf("Error!\nViews do not match the stream contents\n");
+		return 1;
+	}
+
+	plFClose(viewMemFile);
+	plFClose(viewBufFile);
+	printf("Done\n");
+
+	printf("Iterating over lines longer than the buffer...");
+	string_t lineText = "short\n\na line longer than the buffer\nlast";
+	string_t expectedLines[4] = { "short", "", "a line longer than the buffer", "last" };
+	plfile_t* lineStreams[2] = { plFOpen(NULL, "w+", mt), plFToP(tmpfile(), "w+", mt) };
+
+	plFSetBuf(lineStreams[1], 8, PLF_FLUSH_FULL);
+	for(int i = 0; i < 2; i++){
+		plFPuts(lineText, lineStreams[i]);
+		plFSeek(lineStreams[i], 0, SEEK_SET);
+
+		for(int j = 0; j < 4; j++){
+			plarray_t line = plFNextLine(lineStreams[i]);
+
+			if(line.array == NULL || line.size != strlen(expectedLines[j]) || memcmp(line.array, expectedLines[j], line.size) != 0){
+				printf("Error!\nLine %d of stream %d does not match\n", j, i);
+				return 1;
+			}
+		}
+
+		if(plFNextLine(lineStreams[i]).array != NULL){
+			printf("Error!\nStream %d did not end after the last line\n", i);
+			return 1;
+		}
+
+		plFClose(lineStreams[i]);
+	}
+	printf("Done\n");
+
+	printf("Concatenating binary data between stream types...");
+	byte_t catData[10240];
+	plfile_t* catMemSrc = plFOpen(NULL, "w+", mt);
+	plfile_t* catFile = plFToP(tmpfile(), "w+", mt);
+	plfile_t* catFile2 = plFToP(tmpfile(), "w+", mt);
+	plfile_t* catMemDest = plFOpen(NULL, "w+", mt);
+
+	for(int i = 0; i < 10240; i++)
+		catData[i] = i % 256;
+	plFWrite(catData, 1, 10240, catMemSrc);
+
+	/* Memory to file, file to file, file to memory, then memory to memory at the end of the last stream */
+	size_t catSizes[4] = { plFCat(catFile, catMemSrc, SEEK_SET, SEEK_SET, false), plFCat(catFile2, catFile, SEEK_SET, SEEK_SET, false), plFCat(catMemDest, catFile2, SEEK_SET, SEEK_SET, false), plFCat(catMemDest, catMemSrc, SEEK_END, SEEK_SET, false) };
+	plFSeek(catMemDest, 0, SEEK_SET);
+	plarray_t catView = plFView(catMemDest);
+	if(catSizes[0] != 10240 || catSizes[1] != 10240 || catSizes[2] != 10240 || catSizes[3] != 10240 || catView.size != 20480 || memcmp(catView.array, catData, 10240) != 0 || memcmp((byte_t*)catView.array + 10240, catData, 10240) != 0){
+		printf("Error!\nConcatenated data does not match\n");
+		return 1;
+	}
+
+	plFClose(catMemSrc);
+	plFClose(catFile);
+	plFClose(catFile2);
+	plFClose(catMemDest);
+	printf("Done\n");
+
+	printf("Growing a file in memory one byte at a time...");
+	plmt_t* growMT = plMTInit(0);
+	plfile_t* growFile = plFOpen(NULL, "w+", growMT);
+	size_t growBase = plMTMemAmnt(growMT, PLMT_GET_USEDMEM, 0);
+	plmtstats_t growStats;
+
+	plFReserve(growFile, 100);
+	bool isReserved = plMTMemAmnt(growMT, PLMT_GET_USEDMEM, 0) == growBase + 100;
+	for(int i = 0; i < 100000; i++)
+		plFPutC(i % 256, growFile);
+
+	/* Geometric growth only needs about a dozen reallocations, the final capacity is at most twice the length */
+	size_t grownSize = plMTMemAmnt(growMT, PLMT_GET_USEDMEM, 0) - growBase;
+	bool isGeometric = grownSize >= 100000 && grownSize <= 200000 && (plMTGetStats(growMT, &growStats) != 0 || growStats.reallocAmnt <= 12);
+	plFShrink(growFile);
+	plFSeek(growFile, -1, SEEK_END);
+	if(!isReserved || !isGeometric || plMTMemAmnt(growMT, PLMT_GET_USEDMEM, 0) != growBase + 100000 || plFGetC(growFile) != 99999 % 256){
+		printf("Error!\nFile in memory did not grow or shrink properly\n");
+		return 1;
+	}
+
+	plFClose(growFile);
+	plMTStop(growMT);
+	printf("Done\n");
+
+	printf("Reading a memory-mapped file...");
+	char firstLine[4096] = "";
+	size_t usageBeforeMap = plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0);
+	plfile_t* mappedFile = plFOpen(filepath, "rm", mt);
+	plfile_t* lineFile = plFOpen(filepath, "r", mt);
+
+	plFSeek(mappedFile, 0, SEEK_END);
+	size_t mappedSize = plFTell(mappedFile);
+	plFSeek(mappedFile, 0, SEEK_SET);
+	plFGets(firstLine, 4095, lineFile);
+	if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) < usageBeforeMap + mappedSize || plFGets(stringBuffer, 4095, mappedFile) == NULL || strcmp(stringBuffer, firstLine) != 0 || plFPutC('x', mappedFile) != EOF){
+		printf("Error!\nMapped file was not read or accounted properly\n");
+		return 1;
+	}
+
+	plFClose(lineFile);
+	plFClose(mappedFile);
+	if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != usageBeforeMap){
+		printf("Error!\nMapped file was not given back to the memory tracker\n");
+		return 1;
+	}
+
+	/* Files too big for the memory tracker are read through a buffer instead */
+	plmt_t* mapMT = plMTInit(PLF_BUFSIZE + 16384);
+	plfile_t* bigFile = plFOpen("pl32-test-map.tmp", "w", mt);
+	for(int i = 0; i < 2000; i++)
+		plFPuts("Line of a file that is too big to be mapped\n", bigFile);
+
+	plFClose(bigFile);
+	bigFile = plFOpen("pl32-test-map.tmp", "rm", mapMT);
+	bool isBigValid = plFGets(stringBuffer, 4095, bigFile) != NULL && strcmp(stringBuffer, "Line of a file that is too big to be mapped\n") == 0;
+	plFSeek(bigFile, 0, SEEK_END);
+	isBigValid = isBigValid && plFTell(bigFile) == 2000 * 44 && plMTMemAmnt(mapMT, PLMT_GET_USEDMEM, 0) < 2000 * 44;
+	plFClose(bigFile);
+	plMTStop(mapMT);
+	remove("pl32-test-map.tmp");
+	if(!isBigValid){
+		printf("Error!\nFile too big to be mapped was not read properly\n");
+		return 1;
+	}
+
+	printf("Done\n");
+
+	printf("Converting FILE pointers that have read ahead...");
+	int readAheadPipe[2];
+	FILE* readAheadPtrs[2] = { tmpfile(), NULL };
+
+	/* The pipe can't seek, so only its FILE pointer has the bytes it read ahead */
+	if(pipe(readAheadPipe) == 0){
+		write(readAheadPipe[1], "first line\nsecond line\n", 23);
+		close(readAheadPipe[1]);
+		readAheadPtrs[1] = fdopen(readAheadPipe[0], "r");
+	}
+	fputs("first line\nsecond line\n", readAheadPtrs[0]);
+	rewind(readAheadPtrs[0]);
+
+	for(int i = 0; i < 2; i++){
+		/* The whole file is in the buffer of the FILE pointer, and the first byte was pushed back */
+		bool isReadAheadValid = readAheadPtrs[i] != NULL && fgetc(readAheadPtrs[i]) == 'f' && ungetc('F', readAheadPtrs[i]) == 'F';
+		plfile_t* readAheadFile = plFToP(readAheadPtrs[i], "r", mt);
+		isReadAheadValid = isReadAheadValid && plFGets(stringBuffer, 4095, readAheadFile) != NULL && strcmp(stringBuffer, "First line\n") == 0;
+		isReadAheadValid = isReadAheadValid && plFGets(stringBuffer, 4095, readAheadFile) != NULL && strcmp(stringBuffer, "second line\n") == 0 && plFGetC(readAheadFile) == EOF;
+		plFClose(readAheadFile);
+		if(!isReadAheadValid){
+			printf("Error!\nBuffered bytes of FILE pointer %d were lost\n", i);
+			return 1;
+		}
+	}
+
+	printf("Done\n");
+
+	printf("Gathering and scattering pieces...");
+	byte_t bigPiece[3000];
+	byte_t readPieces[3][3000];
+	plarray_t gatherPieces[4] = { { "token ", 6, false, NULL }, { bigPiece, 3000, false, NULL }, { "", 0, false, NULL }, { "end\n", 4, false, NULL } };
+	plfile_t* gatherStreams[2] = { plFToP(tmpfile(), "w+", mt), plFOpen(NULL, "w+", mt) };
+
+	memset(bigPiece, 'x', 3000);
+	plFSetBuf(gatherStreams[0], 16, PLF_FLUSH_FULL);
+	for(int i = 0; i < 2; i++){
+		plarray_t scatterPieces[3] = { { readPieces[0], 6, false, NULL }, { readPieces[1], 3000, false, NULL }, { readPieces[2], 4, false, NULL } };
+
+		/* Twice in a row, so small pieces are both copied after a big one and left in the buffer */
+		if(plFWritev(gatherStreams[i], gatherPieces, 4) != 3010 || plFWritev(gatherStreams[i], gatherPieces, 4) != 3010){
+			printf("Error!\nPieces were not written to stream %d\n", i);
+			return 1;
+		}
+
+		plFSeek(gatherStreams[i], 3010, SEEK_SET);
+		if(plFReadv(gatherStreams[i], scatterPieces, 3) != 3010 || memcmp(readPieces[0], "token ", 6) != 0 || memcmp(readPieces[1], bigPiece, 3000) != 0 || memcmp(readPieces[2], "end\n", 4) != 0 || plFGetC(gatherStreams[i]) != EOF){
+			printf("Error!\nPieces of stream %d do not match\n", i);
+			return 1;
+		}
+
+		plFClose(gatherStreams[i]);
+	}
+	printf("Done\n");
+
+	printf("Compressing and seeking through frames...");
+	size_t rawSize = 200000;
+	byte_t* rawData = plMTAlloc(mt, rawSize);
+	byte_t* readBack = plMTAlloc(mt, 20000);
+	plfile_t* packedFile = plFOpen(NULL, "w+", mt);
+	plfile_t* lzFile = plFOpenCompressed(packedFile, "w", false);
+	uint32_t randomState = 1;
+
+	/* Text that compresses well, followed by noise that has to be stored as is */
+	for(size_t i = 0; i < 150000; i++)
+		rawData[i] = "line of a spill file\n"[i % 21] + (i / 21000);
+	for(size_t i = 150000; i < rawSize; i++){
+		randomState = randomState * 1103515245 + 12345;
+		rawData[i] = randomState >> 16;
+	}
+
+	bool isLZValid = plFWrite(rawData, 1, rawSize, lzFile) == rawSize && plFClose(lzFile) == 0;
+	size_t packedSize = plFTell(packedFile);
+
+	plFSeek(packedFile, 0, SEEK_SET);
+	lzFile = plFOpenCompressed(packedFile, "r", true);
+	isLZValid = isLZValid && packedSize < 100000 && plFRead(readBack, 1, 4096, lzFile) == 4096 && memcmp(readBack, rawData, 4096) == 0;
+	isLZValid = isLZValid && plFSeek(lzFile, 0, SEEK_END) == 0 && plFTell(lzFile) == rawSize;
+	isLZValid = isLZValid && plFSeek(lzFile, 140000, SEEK_SET) == 0 && plFRead(readBack, 1, 20000, lzFile) == 20000 && memcmp(readBack, rawData + 140000, 20000) == 0;
+	isLZValid = isLZValid && plFSeek(lzFile, -159990, SEEK_CUR) == 0 && plFGetC(lzFile) == rawData[10] && plFSeek(lzFile, 1, SEEK_END) != 0;
+	if(!isLZValid){
+		printf("Error!\nCompressed stream does not match what was written\n");
+		return 1;
+	}
+
+	plFClose(lzFile);
+	plMTFree(mt, rawData);
+	plMTFree(mt, readBack);
+	printf("Done\n");
+
+	printf("Reading with access hints and readahead...");
+	plfile_t* hintFile = plFToP(tmpfile(), "w+", mt);
+	plfile_t* hintMemFile = plFOpen(NULL, "w+", mt);
+	byte_t hintBlock[4096];
+	bool isHintValid = true;
+
+	for(int i = 0; i < 256; i++){
+		memset(hintBlock, i, 4096);
+		plFWrite(hintBlock, 1, 4096, hintFile);
+	}
+
+	plFSeek(hintFile, 0, SEEK_SET);
+	isHintValid = plFAdvise(hintFile, PLF_ADVISE_SEQUENTIAL) == 0 && plFSetReadahead(hintFile, 65536) == 0 && plFAdvise(hintMemFile, PLF_ADVISE_WILLNEED) == 0 && plFSetReadahead(hintMemFile, 65536) != 0;
+	for(int i = 0; i < 256 && isHintValid; i++)
+		isHintValid = plFRead(hintBlock, 1, 4096, hintFile) == 4096 && hintBlock[0] == i && hintBlock[4095] == i;
+
+	if(!isHintValid || plFSetReadahead(hintFile, 0) != 0 || plFAdvise(hintFile, PLF_ADVISE_DONTNEED) != 0){
+		printf("Error!\nHinted file was not read back properly\n");
+		return 1;
+	}
+
+	plFClose(hintFile);
+	plFClose(hintMemFile);
+	printf("Done\n");
+
+	printf("Spilling a file in memory into a temporary file...");
+	plfile_t* spillFile = plFOpen(NULL, "w+", mt);
+	size_t spillBaseUsage = plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0);
+	size_t spillPeakUsage = 0;
+	bool isSpillValid = plFSetSpill(spillFile, 8192) == 0 && plFReserve(spillFile, 16384) != 0;
+
+	for(int i = 0; i < 5000 && isSpillValid; i++){
+		char spillLine[64];
+
+		snprintf(spillLine, 64, "Spilled line %d of the file\n", i);
+		isSpillValid = plFPuts(spillLine, spillFile) == 0;
+		if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) - spillBaseUsage > spillPeakUsage)
+			spillPeakUsage = plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) - spillBaseUsage;
+	}
+
+	plFSeek(spillFile, 0, SEEK_SET);
+	for(int i = 0; i < 5000 && isSpillValid; i++){
+		char spillLine[64];
+		char readLine[64];
+
+		snprintf(spillLine, 64, "Spilled line %d of the file\n", i);
+		isSpillValid = plFGets(readLine, 64, spillFile) != NULL && strcmp(spillLine, readLine) == 0;
+	}
+
+	/* Memory use stays around the size of the write buffer that replaced the contents */
+	if(!isSpillValid || spillPeakUsage > PLF_BUFSIZE + 16384 || plFTell(spillFile) < 100000){
+		printf("Error!\nSpilled file was not read back properly\n");
+		return 1;
+	}
+
+	plFClose(spillFile);
+	printf("Done\n");
+
+	/* io_uring might be unavailable, so the automatic backend is tested along with the thread pool */
+	plfaiobackend_t backends[2] = { PLF_AIO_AUTO, PLF_AIO_THREADS };
+	for(int i = 0; i < 2; i++){
+		printf("Writing and reading blocks asynchronously (backend %d)...", i);
+		plfaio_t* aio = plFAioInit(8, backends[i], mt);
+		plfile_t* asyncFiles[2] = { plFToP(tmpfile(), "w+", mt), plFOpen(NULL, "w+", mt) };
+		plfaioresult_t results[16];
+		byte_t block[256];
+		size_t resultAmnt = 0;
+
+		for(int j = 0; j < 16; j++){
+			memset(block, 'a' + j, 256);
+			plFWriteAsync(aio, asyncFiles[j % 2], (j / 2) * 256, block, 256, (memptr_t)(intptr_t)j);
+		}
+		plFAioSubmit(aio);
+		while(resultAmnt < 16)
+			resultAmnt += plFAioReap(aio, results, 16, true);
+
+		size_t usageBeforeRead = plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0);
+		for(int j = 0; j < 16; j++)
+			plFReadAsync(aio, asyncFiles[j % 2], (j / 2) * 256, 256, (memptr_t)(intptr_t)j);
+
+		resultAmnt = 0;
+		while(resultAmnt < 16){
+			size_t reapedAmnt = plFAioReap(aio, results, 16, true);
+
+			for(size_t k = 0; k < reapedAmnt; k++){
+				int j = (intptr_t)results[k].userData;
+
+				if(results[k].result != 256 || ((byte_t*)results[k].buffer.array)[255] != 'a' + j){
+					printf("Error!\nBlock %d was not read back properly\n", j);
+					return 1;
+				}
+				plMTFree(results[k].buffer.mt, results[k].buffer.array);
+			}
+			resultAmnt += reapedAmnt;
+		}
+
+		if(plMTMemAmnt(mt, PLMT_GET_USEDMEM, 0) != usageBeforeRead){
+			printf("Error!\nRequest buffers were not given back to the memory tracker\n");
+			return 1;
+		}
+
+		plFAioStop(aio);
+		plFClose(asyncFiles[0]);
+		plFClose(asyncFiles[1]);
+		printf("Done\n");
+	}
+
+	/* The ends are used from two threads, so they need a shared tracker */
+	printf("Passing lines through a pipe between threads...");
+	plmt_t* pipeMT = plMTInitShared(4 * 1024 * 1024);
+	plfile_t* pipeEnds[2];
+	pthread_t pipeThread;
+	bool isPipeValid = plFPipe(pipeEnds, 4000, true, mt) == 1 && plFPipe(pipeEnds, 4000, true, pipeMT) == 0;
+	plarray_t pipeLine;
+	int lineNum = 0;
+
+	if(isPipeValid)
+		pthread_create(&pipeThread, NULL, pipeTestThread, pipeEnds[1]);
+
+	while(isPipeValid && (pipeLine = plFNextLine(pipeEnds[0])).array != NULL){
+		char expectedLine[64];
+
+		snprintf(expectedLine, 64, "Piped line %d", lineNum++);
+		isPipeValid = pipeLine.size == strlen(expectedLine) && memcmp(pipeLine.array, expectedLine, pipeLine.size) == 0;
+	}
+
+	if(isPipeValid)
+		pthread_join(pipeThread, NULL);
+
+	if(!isPipeValid || lineNum != 20000 || plFSeek(pipeEnds[0], 0, SEEK_SET) == 0){
+		printf("Error!\nLines were not passed through the pipe properly\n");
+		return 1;
+	}
+
+	plFClose(pipeEnds[0]);
+
+	/* Non-blocking ends never wait, and incomplete lines stay in the pipe */
+	isPipeValid = plFPipe(pipeEnds, 64, false, pipeMT) == 0 && plFWrite(stringBuffer, 1, 100, pipeEnds[1]) == 0 && errno == EAGAIN;
+	isPipeValid = isPipeValid && plFPuts("abc\nde", pipeEnds[1]) == 0 && plFFlush(pipeEnds[1]) == 0;
+	isPipeValid = isPipeValid && (pipeLine = plFNextLine(pipeEnds[0])).size == 3 && memcmp(pipeLine.array, "abc", 3) == 0;
+	isPipeValid = isPipeValid && plFNextLine(pipeEnds[0]).array == NULL && errno == EAGAIN;
+	isPipeValid = isPipeValid && plFPuts("f\n", pipeEnds[1]) == 0 && plFClose(pipeEnds[1]) == 0;
+	isPipeValid = isPipeValid && (pipeLine = plFNextLine(pipeEnds[0])).size == 3 && memcmp(pipeLine.array, "def", 3) == 0;
+	errno = 0;
+	if(!isPipeValid || plFNextLine(pipeEnds[0]).array != NULL || errno == EAGAIN){
+		printf("Error!\nNon-blocking pipe did not behave properly\n");
+		return 1;
+	}
+
+	plFClose(pipeEnds[0]);
+	plMTStop(pipeMT);
+	printf("Done\n");
+
 	return 0;
 }
 
@@ -3,287 +3,2812 @@
  (c) 2022 pocketlinux32, Under MPL v2.0
  pl32-file.c: File management module
 \****************************************************/
+#define _GNU_SOURCE
 #include <pl32-file.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#else
+#include <sched.h>
+#endif
+
+/* io_uring is used through raw system calls, so only the kernel headers are needed */
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef __NR_io_uring_setup
+#define PLF_HAVE_IOURING
+#endif
+#endif
+#endif
+
+/* Largest amount of bytes plFCat asks the kernel to copy at once */
+#define PLF_CAT_CHUNK ((size_t)1 << 30)
+
+/* Uncompressed size of the frames of compressed streams, which keeps match offsets within 16 bits */
+#define PLF_LZ_BLOCKSIZE 65536
+/* Size of the header of every frame, holding its uncompressed and compressed size */
+#define PLF_LZ_HEADERSIZE 8
+#define PLF_LZ_HASHBITS 12
+#define PLF_LZ_MINMATCH 4
+/* File descriptor of compressed streams, which are handled like actual files whose system calls go through their filter */
+#define PLF_FILTER_FD -2
+
+/* File descriptor of pipe ends, which are handled like actual files whose system calls go through their ring */
+#define PLF_PIPE_FD -3
+/* Distance kept between the parts of a pipe written by each end, so they don't share a cache line */
+#define PLF_CACHELINE 64
+
+/* Most iovecs handed to readv or writev at once by plFReadv and plFWritev */
+#define PLF_IOV_BATCH 64
+/* Pieces smaller than this are copied into the buffer by plFWritev instead of getting their own iovec */
+#define PLF_IOV_COPYSIZE 1024
+
+/* Size of the reads done by the readahead thread of an actual file */
+#define PLF_READAHEAD_CHUNK 262144
+
+/* Amount of worker threads used by asynchronous I/O contexts without io_uring */
+#define PLF_AIO_WORKERS 4
 
 struct plfile {
-	FILE* fileptr; /* File pointer for actual files */
-	byte_t* strbuf; /* String pointer for stringstream */
-	size_t seekbyte; /* Byte offset from the beginning of buffer */
+	plfilebuf_t buf; /* Buffer window used by the inline functions in pl32-file.h. Must be the first member */
+	int fd; /* File descriptor for actual files, -1 for files in memory */
+	FILE* fileptr; /* File pointer given to plFToP, which the stream reads and writes through. Closed along with the stream */
+	bool isLineRead; /* fileptr isn't a regular file, so reads through it stop at the end of a line */
+	byte_t* strbuf; /* Contents of a file in memory, or the read/write buffer of an actual file */
+	size_t seekbyte; /* Byte offset from the beginning of a file in memory, while no window is open */
 	size_t bufsize; /* Buffer size */
+	size_t datasize; /* Length of the contents of a file in memory */
+	bool isMapped; /* strbuf is a read-only mapping of an actual file, which is handled like a file in memory */
+	plfflush_t flushMode;
+	size_t spillSize; /* Size past which a file in memory moves into a temporary file, or 0 if it never does */
+	bool isSpilled; /* Actual file that used to be a file in memory (See plFSetSpill) */
+	struct plfreadahead* readahead; /* Background readahead of an actual file, set by plFSetReadahead */
+	struct plflz* filter; /* Compression filter of a compressed stream (See plFOpenCompressed) */
+	struct plfpipe* pipe; /* Ring buffer shared by both ends of a pipe (See plFPipe) */
 	plmt_t* mtptr; /* pointer to MT (see pl32-memory.h) */
 };
 
-/* Opens a file stream. If filename is NULL, a file-in-memory is returned */
-plfile_t* plFOpen(string_t filename, string_t mode, plmt_t* mt){
-	if(mt == NULL)
-		plPanic("plFOpen: Memory tracker was set to NULL", false, true);
+/* Internal type for an entry of the frame index of a compressed stream */
+typedef struct plflzframe {
+	size_t rawOffset; /* Uncompressed offset of the first byte of the frame */
+	size_t baseOffset; /* Offset of the frame header in the base stream */
+} plflzframe_t;
 
-	plfile_t* returnStruct = plMTAllocE(mt, sizeof(plfile_t));
+/* Internal type for the compression filter of a compressed stream. Frames are an 8 byte header with *\
+|* the uncompressed and compressed sizes in little endian, followed by the compressed data, or the   *|
+\* uncompressed data if both sizes are the same                                                      */
+typedef struct plflz {
+	plfile_t* base; /* Stream holding the frames */
+	byte_t* block; /* Uncompressed contents of the current frame */
+	byte_t* packed; /* Compressed contents of the current frame */
+	size_t blockPos; /* Position of reads inside the block */
+	size_t blockSize;
+	size_t blockOffset; /* Uncompressed offset of the start of the block */
+	size_t nextFrame; /* Number of the frame after the block */
+	size_t nextFrameBase; /* Offset of the frame after the block in the base stream */
+	size_t basePos; /* Position of the base stream, or SIZE_MAX if it's unknown */
+	plflzframe_t* index; /* Every frame found so far, in order */
+	size_t indexSize;
+	size_t indexCapacity;
+	bool isWrite;
+	bool closeBase;
+} plflz_t;
 
-	/* If no filename is given, set up a file in memory */
-	if(filename == NULL){
-		returnStruct->fileptr = NULL;
-		returnStruct->strbuf = plMTAllocE(mt, 4098);
-		returnStruct->bufsize = 4098;
-	}else{
-		if(mode == NULL)
-			plPanic("plFOpen: File mode was set to NULL", false, true);
+/* Internal type for the background readahead of an actual file. Protected by lock */
+typedef struct plfreadahead {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int fd;
+	byte_t* scratch; /* Where prefetched data gets read into and thrown away */
+	size_t windowSize; /* Amount of bytes prefetched ahead of the caller */
+	off_t requestPos; /* File offset the caller has read up to */
+	off_t donePos; /* End of the range that has been prefetched */
+	bool isRequested;
+	bool isStopping;
+} plfreadahead_t;
 
-		returnStruct->fileptr = fopen(filename, mode);
-		returnStruct->bufsize = 0;
-		returnStruct->strbuf = NULL;
+/* Internal type for the ring buffer shared by both ends of a pipe. Each end only writes its own half, *\
+|* so neither needs a lock. The byte counts only grow, and an end only loads the count of the other   *|
+|* one once its cached copy runs out. An end that has to wait sleeps on the futex word bumped by the  *|
+\* other end, which only makes a system call to wake it if it's waiting                              */
+typedef struct plfpipe {
+	/* Written by the read end */
+	size_t readCount; /* Total amount of bytes read from the ring */
+	size_t cachedWriteCount;
+	uint32_t spaceSeq; /* Futex word bumped whenever space is freed while the write end is waiting */
+	bool isReaderWaiting;
+	bool isReaderClosed;
+	bool isReadBlocking;
+	byte_t readPad[PLF_CACHELINE];
+
+	/* Written by the write end */
+	size_t writeCount; /* Total amount of bytes written into the ring */
+	size_t cachedReadCount;
+	uint32_t dataSeq; /* Futex word bumped whenever data is committed while the read end is waiting */
+	bool isWriterWaiting;
+	bool isWriterClosed;
+	bool isWriteBlocking;
+	byte_t writePad[PLF_CACHELINE];
 
-		if(returnStruct->fileptr == NULL){
-			plPanic("plFOpen", true, false);
+	byte_t* ring;
+	size_t capacity; /* Size of the ring, which is a power of 2 */
+	plfile_t* readEnd;
+	plfile_t* writeEnd;
+	int openEnds;
+} plfpipe_t;
+
+/* Internal type for an asynchronous read or write. buffer comes from the memory tracker of the stream */
+typedef struct plfaioreq {
+	struct plfaioreq* next;
+	plfile_t* stream;
+	memptr_t userData;
+	struct iovec iov; /* Buffer and size of the request */
+	off_t offset;
+	int64_t result;
+	bool isWrite;
+} plfaioreq_t;
+
+/* Internal type for a linked list of requests that gets appended at the tail */
+typedef struct plfaioqueue {
+	plfaioreq_t* head;
+	plfaioreq_t* tail;
+} plfaioqueue_t;
+
+struct plfaio {
+	plmt_t* mt;
+	plfaioqueue_t queued; /* Requests waiting for plFAioSubmit */
+	plfaioqueue_t completed; /* Finished requests waiting for plFAioReap, protected by lock */
+	size_t inFlightAmnt; /* Requests submitted but not reaped yet, protected by lock */
+	plfaiobackend_t backend;
+	pthread_mutex_t lock;
+	pthread_cond_t doneCond;
+	/* Thread pool state */
+	plfaioqueue_t pending; /* Requests waiting for a worker, protected by lock */
+	pthread_cond_t workCond;
+	pthread_t workers[PLF_AIO_WORKERS];
+	bool isStopping;
+#ifdef PLF_HAVE_IOURING
+	/* io_uring state */
+	int ringFd;
+	unsigned int sqEntries;
+	unsigned int cqEntries;
+	unsigned int unsubmittedAmnt; /* Entries in the submission ring that the kernel hasn't taken yet */
+	byte_t* sqRing;
+	size_t sqRingSize;
+	byte_t* cqRing;
+	size_t cqRingSize;
+	struct io_uring_sqe* sqes;
+	size_t sqesSize;
+	unsigned int* sqHead;
+	unsigned int* sqTail;
+	unsigned int* sqMask;
+	unsigned int* sqArray;
+	unsigned int* cqHead;
+	unsigned int* cqTail;
+	unsigned int* cqMask;
+	struct io_uring_cqe* cqes;
+#endif
+};
+
+/* External definitions of the inline functions in pl32-file.h */
+extern inline int plFPutC(byte_t ch, plfile_t* stream);
+extern inline int plFGetC(plfile_t* stream);
+extern inline int plFPuts(string_t string, plfile_t* stream);
+extern inline string_t plFGets(string_t string, int num, plfile_t* stream);
+
+/* Converts an fopen()-style mode string into open() flags. Returns -1 if the mode is invalid */
+static int plFModeFlags(string_t mode){
+	int flags;
+
+	switch(mode[0]){
+		case 'r':
+			flags = O_RDONLY;
+			break;
+		case 'w':
+			flags = O_WRONLY | O_CREAT | O_TRUNC;
+			break;
+		case 'a':
+			flags = O_WRONLY | O_CREAT | O_APPEND;
+			break;
+		default:
+			return -1;
+	}
+
+	for(int i = 1; mode[i] != '\0'; i++){
+		switch(mode[i]){
+			case '+':
+				flags = (flags & ~O_ACCMODE) | O_RDWR;
+				break;
+			case 'x':
+				flags |= O_EXCL;
+				break;
+			case 'e':
+				flags |= O_CLOEXEC;
+				break;
+			case 'm':
+				/* Handled by plFOpen */
+				break;
 		}
 	}
 
-	returnStruct->mtptr = mt;
-	returnStruct->seekbyte = 0;
+	return flags;
+}
 
+/* Creates a stream for an actual file, or for a file in memory if fd is -1. Every kind of stream *\
+|* starts out from here and only changes what differs. Terminals are line flushed, everything else *|
+\* is fully flushed                                                                                */
+static plfile_t* plFInitFile(int fd, plmt_t* mt){
+	plfile_t* returnStruct = plMTAllocE(mt, sizeof(plfile_t));
+
+	memset(&returnStruct->buf, 0, sizeof(plfilebuf_t));
+	returnStruct->fd = fd;
+	returnStruct->fileptr = NULL;
+	returnStruct->isLineRead = false;
+	returnStruct->strbuf = NULL;
+	returnStruct->seekbyte = 0;
+	returnStruct->bufsize = PLF_BUFSIZE;
+	returnStruct->datasize = 0;
+	returnStruct->isMapped = false;
+	returnStruct->flushMode = (fd >= 0 && isatty(fd)) ? PLF_FLUSH_LINE : PLF_FLUSH_FULL;
+	returnStruct->buf.isLineFlushed = returnStruct->flushMode == PLF_FLUSH_LINE;
+	returnStruct->spillSize = 0;
+	returnStruct->isSpilled = false;
+	returnStruct->readahead = NULL;
+	returnStruct->filter = NULL;
+	returnStruct->pipe = NULL;
+	returnStruct->mtptr = mt;
 
 	return returnStruct;
 }
 
-/* Converts a FILE pointer into a plfile_t pointer */
-plfile_t* plFToP(FILE* pointer, string_t mode, plmt_t* mt){
-	if(pointer == NULL)
-		return NULL;
+/* Fetches 4 bytes at once for the match finder of the LZ codec */
+static uint32_t plFLZRead32(const byte_t* ptr){
+	uint32_t value;
 
-	plfile_t* returnPointer = plFOpen(NULL, NULL, mt);
-	returnPointer->fileptr = pointer;
-	returnPointer->bufsize = 0;
-	plMTFree(mt, returnPointer->strbuf);
-	return returnPointer;
+	memcpy(&value, ptr, 4);
+	return value;
 }
 
-/* Closes a file stream */
-int plFClose(plfile_t* ptr){
-	if(ptr == NULL)
-		return 1;
+/* Fetches 8 bytes at once for extending matches of the LZ codec */
+static uint64_t plFLZRead64(const byte_t* ptr){
+	uint64_t value;
 
-	if(ptr->fileptr == NULL){
-		plMTFree(ptr->mtptr, ptr->strbuf);
-	}else{
-		if(fclose(ptr->fileptr))
-			return 1;
+	memcpy(&value, ptr, 8);
+	return value;
+}
+
+/* Writes the part of a sequence length that doesn't fit in its token. Returns NULL if it doesn't fit in dest */
+static byte_t* plFLZPutLength(byte_t* dest, byte_t* destEnd, size_t length){
+	while(length >= 255){
+		if(dest == destEnd)
+			return NULL;
+
+		*dest++ = 255;
+		length -= 255;
 	}
 
-	plMTFree(ptr->mtptr, ptr);
-	return 0;
+	if(dest == destEnd)
+		return NULL;
+
+	*dest++ = length;
+	return dest;
 }
 
-/* Reads size * nmemb amount of bytes from the file stream */
-size_t plFRead(void* ptr, size_t size, size_t nmemb, plfile_t* stream){
-	if(stream == NULL)
-		return 0;
+/* Writes a sequence of literals followed by a match of matchSize bytes at offset. A matchSize of 0 *\
+\* writes the literals at the end of a frame. Returns NULL if the sequence doesn't fit in dest      */
+static byte_t* plFLZPutSequence(byte_t* dest, byte_t* destEnd, const byte_t* literals, size_t literalSize, size_t offset, size_t matchSize){
+	if(dest == destEnd)
+		return NULL;
+
+	byte_t* token = dest++;
+	*token = ((literalSize >= 15) ? 15 : literalSize) << 4;
+	if(literalSize >= 15 && (dest = plFLZPutLength(dest, destEnd, literalSize - 15)) == NULL)
+		return NULL;
+
+	if(literalSize > (size_t)(destEnd - dest))
+		return NULL;
+
+	memcpy(dest, literals, literalSize);
+	dest += literalSize;
+	if(matchSize == 0)
+		return dest;
+
+	if(destEnd - dest < 2)
+		return NULL;
+
+	*dest++ = offset & 255;
+	*dest++ = offset >> 8;
+
+	matchSize -= PLF_LZ_MINMATCH;
+	*token |= (matchSize >= 15) ? 15 : matchSize;
+	if(matchSize >= 15)
+		return plFLZPutLength(dest, destEnd, matchSize - 15);
+
+	return dest;
+}
 
-	if(stream->fileptr == NULL){
-		int elementAmnt = 1;
-		while(size * elementAmnt < stream->bufsize - stream->seekbyte && elementAmnt < nmemb){
-			elementAmnt++;
+/* Compresses up to PLF_LZ_BLOCKSIZE bytes with an LZ77 codec in the style of LZ4. Every sequence is a *\
+|* token with the literal and match lengths, the literals and a 16-bit match offset. Returns the      *|
+\* compressed size, or 0 if it doesn't fit in destSize                                                 */
+static size_t plFLZCompress(const byte_t* src, size_t srcSize, byte_t* dest, size_t destSize){
+	uint16_t hashTable[1 << PLF_LZ_HASHBITS];
+	const byte_t* srcPos = src;
+	const byte_t* literals = src;
+	const byte_t* srcEnd = src + srcSize;
+	byte_t* destPos = dest;
+	byte_t* destEnd = dest + destSize;
+	size_t missAmnt = 0;
+
+	memset(hashTable, 0, sizeof(hashTable));
+	while(srcEnd - srcPos >= PLF_LZ_MINMATCH){
+		uint32_t sequence = plFLZRead32(srcPos);
+		uint32_t hash = (sequence * 2654435761u) >> (32 - PLF_LZ_HASHBITS);
+		const byte_t* match = src + hashTable[hash];
+
+		hashTable[hash] = srcPos - src;
+		if(match >= srcPos || plFLZRead32(match) != sequence){
+			/* Incompressible data gets skipped faster the longer it goes on */
+			srcPos += 1 + (missAmnt++ >> 6);
+			continue;
 		}
-		elementAmnt--;
 
-		if(elementAmnt == 0){
+		/* Matches get extended 8 bytes at a time, then byte by byte */
+		size_t matchSize = PLF_LZ_MINMATCH;
+		while(srcEnd - srcPos - matchSize >= 8 && plFLZRead64(match + matchSize) == plFLZRead64(srcPos + matchSize))
+			matchSize += 8;
+		while(srcPos + matchSize < srcEnd && match[matchSize] == srcPos[matchSize])
+			matchSize++;
+
+		destPos = plFLZPutSequence(destPos, destEnd, literals, srcPos - literals, srcPos - match, matchSize);
+		if(destPos == NULL)
 			return 0;
-		}
 
-		memcpy(ptr, stream->strbuf + stream->seekbyte, size * elementAmnt);
-		stream->seekbyte += size * elementAmnt;
-		return size * elementAmnt;
-	}else{
-		return fread(ptr, size, nmemb, stream->fileptr);
+		srcPos += matchSize;
+		literals = srcPos;
+		missAmnt = 0;
+
+		/* Indexing the end of the match helps the next one start right after it */
+		if(srcEnd - srcPos >= 2)
+			hashTable[(plFLZRead32(srcPos - 2) * 2654435761u) >> (32 - PLF_LZ_HASHBITS)] = srcPos - 2 - src;
 	}
+
+	destPos = plFLZPutSequence(destPos, destEnd, literals, srcEnd - literals, 0, 0);
+	return (destPos != NULL) ? (size_t)(destPos - dest) : 0;
 }
 
-/* Writes size * nmemb amount of bytes from the file stream */
-size_t plFWrite(void* ptr, size_t size, size_t nmemb, plfile_t* stream){
-	if(stream == NULL)
-		return 0;
+/* Reads the part of a sequence length that didn't fit in its token. Returns 1 if src ends first */
+static int plFLZGetLength(const byte_t** src, const byte_t* srcEnd, size_t* length){
+	byte_t lengthByte;
 
-	if(stream->fileptr == NULL){
-		if(size * nmemb > stream->bufsize - stream->seekbyte){
-			void* tempPtr = plMTRealloc(stream->mtptr, stream->strbuf, stream->bufsize + size * nmemb);
-			if(!tempPtr){
-				return 0;
+	do{
+		if(*src == srcEnd)
+			return 1;
+
+		lengthByte = *(*src)++;
+		*length += lengthByte;
+	}while(lengthByte == 255);
+
+	return 0;
+}
+
+/* Decompresses a frame made by plFLZCompress, checking every length and offset against the buffers. *\
+\* Returns the decompressed size, or SIZE_MAX if the frame is damaged                                  */
+static size_t plFLZDecompress(const byte_t* src, size_t srcSize, byte_t* dest, size_t destSize){
+	const byte_t* srcEnd = src + srcSize;
+	byte_t* destPos = dest;
+	byte_t* destEnd = dest + destSize;
+
+	while(src < srcEnd){
+		byte_t token = *src++;
+		size_t literalSize = token >> 4;
+
+		if(literalSize == 15 && plFLZGetLength(&src, srcEnd, &literalSize))
+			return SIZE_MAX;
+		if(literalSize > (size_t)(srcEnd - src) || literalSize > (size_t)(destEnd - destPos))
+			return SIZE_MAX;
+
+		/* Short runs get copied with a fixed size when both buffers have room for it */
+		if(literalSize <= 16 && srcEnd - src >= 16 && destEnd - destPos >= 16)
+			memcpy(destPos, src, 16);
+		else
+			memcpy(destPos, src, literalSize);
+
+		destPos += literalSize;
+		src += literalSize;
+
+		/* The last sequence only has literals */
+		if(src == srcEnd)
+			break;
+		if(srcEnd - src < 2)
+			return SIZE_MAX;
+
+		size_t offset = src[0] | (src[1] << 8);
+		size_t matchSize = token & 15;
+		src += 2;
+
+		if(matchSize == 15 && plFLZGetLength(&src, srcEnd, &matchSize))
+			return SIZE_MAX;
+
+		matchSize += PLF_LZ_MINMATCH;
+		if(offset == 0 || offset > (size_t)(destPos - dest) || matchSize > (size_t)(destEnd - destPos))
+			return SIZE_MAX;
+
+		/* Matches can overlap themselves to repeat a short run */
+		const byte_t* match = destPos - offset;
+		if(offset >= 8 && (size_t)(destEnd - destPos) >= matchSize + 8){
+			byte_t* matchEnd = destPos + matchSize;
+
+			while(destPos < matchEnd){
+				memcpy(destPos, match, 8);
+				destPos += 8;
+				match += 8;
 			}
 
-			stream->strbuf = tempPtr;
+			destPos = matchEnd;
+		}else{
+			while(matchSize-- > 0)
+				*destPos++ = *match++;
 		}
-		memcpy(stream->strbuf + stream->seekbyte, ptr, size * nmemb);
-		stream->seekbyte += size * nmemb;
-		return size * nmemb;
-	}else{
-		return fwrite(ptr, size, nmemb, stream->fileptr);
 	}
+
+	return destPos - dest;
 }
 
-/* Puts a character into the file stream */
-int plFPutC(byte_t ch, plfile_t* stream){
-	if(stream == NULL)
-		return '\0';
+/* Records where a frame starts in the frame index, if it's the next one missing from it. The *\
+\* index only speeds up seeking, so running out of memory for it isn't an error               */
+static void plFLZAddFrame(plflz_t* lz, size_t frameNum, plflzframe_t frame){
+	if(frameNum != lz->indexSize)
+		return;
 
-	if(stream->fileptr == NULL){
-		if(stream->bufsize - stream->seekbyte < 1){
-			void* tempPtr = plMTRealloc(stream->mtptr, stream->strbuf, stream->bufsize + 1);
+	if(lz->indexSize == lz->indexCapacity){
+		size_t capacity = (lz->indexCapacity == 0) ? 64 : lz->indexCapacity * 2;
+		plflzframe_t* tempPtr = (lz->index == NULL) ? plMTAlloc(lz->base->mtptr, capacity * sizeof(plflzframe_t)) : plMTRealloc(lz->base->mtptr, lz->index, capacity * sizeof(plflzframe_t));
 
-			if(tempPtr == NULL)
-				return '\0';
+		if(tempPtr == NULL)
+			return;
 
-			stream->strbuf = tempPtr;
-		}
+		lz->index = tempPtr;
+		lz->indexCapacity = capacity;
+	}
 
-		return ch;
-	}else{
-		return fputc(ch, stream->fileptr);
+	lz->index[lz->indexSize++] = frame;
+}
+
+/* Reads the header of the frame at the position of the base stream. Returns 1 at the end of the *\
+\* stream, or if the header is damaged, in which case errno is set to EIO                        */
+static int plFLZReadHeader(plflz_t* lz, size_t* rawSize, size_t* packedSize){
+	byte_t header[PLF_LZ_HEADERSIZE];
+	size_t readSize = plFRead(header, 1, PLF_LZ_HEADERSIZE, lz->base);
+
+	if(readSize != PLF_LZ_HEADERSIZE){
+		lz->basePos = SIZE_MAX;
+		if(readSize != 0)
+			errno = EIO;
+
+		return 1;
 	}
+
+	*rawSize = header[0] | (header[1] << 8) | ((size_t)header[2] << 16) | ((size_t)header[3] << 24);
+	*packedSize = header[4] | (header[5] << 8) | ((size_t)header[6] << 16) | ((size_t)header[7] << 24);
+	lz->basePos += PLF_LZ_HEADERSIZE;
+	if(*rawSize == 0 || *rawSize > PLF_LZ_BLOCKSIZE || *packedSize > *rawSize){
+		errno = EIO;
+		return 1;
+	}
+
+	return 0;
 }
 
-/* Gets a character from the file stream */
-int plFGetC(plfile_t* stream){
-	if(stream == NULL)
-		return '\0';
+/* Moves the base stream past the payload of a frame, without reading it if it's not buffered. Returns 1 on failure */
+static int plFLZSkipPayload(plflz_t* lz, size_t packedSize){
+	plarray_t view = plFView(lz->base);
+
+	if(view.size >= packedSize){
+		plFAdvance(lz->base, packedSize);
+	}else if(plFSeek(lz->base, packedSize, SEEK_CUR)){
+		lz->basePos = SIZE_MAX;
+		return 1;
+	}
+
+	lz->basePos += packedSize;
+	return 0;
+}
 
-	if(stream->fileptr == NULL){
-		byte_t ch = '\0';
-		if(stream->seekbyte > stream->bufsize){
-			ch = *(stream->strbuf + stream->seekbyte);
-			stream->seekbyte++;
+/* Loads the frame holding target into the block, starting from frame frameNum. Frames before *\
+|* target only get their headers read and added to the frame index. toEnd goes to the end of  *|
+\* the stream instead, leaving an empty block there. Returns 1 if target is past the end      */
+static int plFLZFindFrame(plflz_t* lz, size_t frameNum, plflzframe_t frame, size_t target, bool toEnd){
+	size_t rawSize;
+	size_t packedSize;
+
+	lz->blockOffset = frame.rawOffset;
+	lz->blockSize = 0;
+	lz->blockPos = 0;
+	lz->nextFrame = frameNum;
+	lz->nextFrameBase = frame.baseOffset;
+
+	if(frame.baseOffset != lz->basePos){
+		if(plFSeek(lz->base, frame.baseOffset, SEEK_SET)){
+			lz->basePos = SIZE_MAX;
+			return 1;
 		}
 
-		return ch;
-	}else{
-		return fgetc(stream->fileptr);
+		lz->basePos = frame.baseOffset;
+	}
+
+	while(true){
+		plFLZAddFrame(lz, frameNum, frame);
+		lz->blockOffset = frame.rawOffset;
+		lz->nextFrame = frameNum;
+		lz->nextFrameBase = frame.baseOffset;
+
+		/* The end of the stream is a valid position with an empty block */
+		if(plFLZReadHeader(lz, &rawSize, &packedSize))
+			return !toEnd && target != frame.rawOffset;
+
+		if(!toEnd && target < frame.rawOffset + rawSize)
+			break;
+
+		if(plFLZSkipPayload(lz, packedSize))
+			return 1;
+
+		frame.rawOffset += rawSize;
+		frame.baseOffset += PLF_LZ_HEADERSIZE + packedSize;
+		frameNum++;
 	}
+
+	/* Stored frames go straight into the block */
+	byte_t* payload = (packedSize == rawSize) ? lz->block : lz->packed;
+	if(plFRead(payload, 1, packedSize, lz->base) != packedSize){
+		lz->basePos = SIZE_MAX;
+		errno = EIO;
+		return 1;
+	}
+
+	lz->basePos += packedSize;
+	if(packedSize != rawSize && plFLZDecompress(lz->packed, packedSize, lz->block, rawSize) != rawSize){
+		errno = EIO;
+		return 1;
+	}
+
+	lz->blockSize = rawSize;
+	lz->blockPos = target - frame.rawOffset;
+	lz->nextFrame = frameNum + 1;
+	lz->nextFrameBase = frame.baseOffset + PLF_LZ_HEADERSIZE + packedSize;
+	return 0;
 }
 
-/* Puts a string into the file stream */
-int plFPuts(string_t string, plfile_t* stream){
-	if(stream == NULL)
+/* Compresses the block into a frame and writes it to the base stream, storing it as is if it *\
+\* doesn't get any smaller. Returns 1 on failure                                             */
+static int plFLZWriteFrame(plflz_t* lz){
+	if(lz->blockSize == 0)
 		return 0;
 
-	if(stream->fileptr == NULL){
-		if(plFWrite(string, 1, strlen(string)+1, stream))
-			return 0;
+	byte_t header[PLF_LZ_HEADERSIZE];
+	byte_t* payload = lz->packed;
+	size_t packedSize = plFLZCompress(lz->block, lz->blockSize, lz->packed, lz->blockSize - 1);
+
+	if(packedSize == 0){
+		payload = lz->block;
+		packedSize = lz->blockSize;
+	}
 
+	for(int i = 0; i < 4; i++){
+		header[i] = lz->blockSize >> (i * 8);
+		header[i + 4] = packedSize >> (i * 8);
+	}
+
+	if(plFWrite(header, 1, PLF_LZ_HEADERSIZE, lz->base) != PLF_LZ_HEADERSIZE || plFWrite(payload, 1, packedSize, lz->base) != packedSize){
+		errno = EIO;
 		return 1;
-	}else{
-		return fputs(string, stream->fileptr);
 	}
+
+	lz->blockOffset += lz->blockSize;
+	lz->blockSize = 0;
+	return 0;
 }
 
-/* Gets a string from the file stream */
-string_t plFGets(string_t string, int num, plfile_t* stream){
-	if(stream == NULL)
-		return NULL;
+/* read() for compressed streams. Returns the amount of bytes read, 0 at the end of the stream *\
+\* and -1 on failure                                                                            */
+static ssize_t plFLZRead(plflz_t* lz, byte_t* dest, size_t size){
+	if(lz->isWrite){
+		errno = EBADF;
+		return -1;
+	}
 
-	if(stream->fileptr == NULL){
-		byte_t* endMark = (byte_t*)strchr((string_t)stream->strbuf + stream->seekbyte, '\n');
-		unsigned int writeNum = 0;
-		if(endMark == NULL)
-			endMark = (byte_t*)strchr((string_t)stream->strbuf + stream->seekbyte, '\0');
+	if(lz->blockPos == lz->blockSize){
+		plflzframe_t frame = { lz->blockOffset + lz->blockSize, lz->nextFrameBase };
+		size_t target = frame.rawOffset;
 
-		writeNum = endMark - (stream->strbuf + stream->seekbyte);
+		errno = 0;
+		if(plFLZFindFrame(lz, lz->nextFrame, frame, target, false) || lz->blockSize == 0)
+			return (errno == EIO) ? -1 : 0;
+	}
 
-		if(writeNum >= num)
-			writeNum = num - 1;
+	size_t availSize = lz->blockSize - lz->blockPos;
+	if(size > availSize)
+		size = availSize;
 
-		if(writeNum == 0)
-			return NULL;
+	memcpy(dest, lz->block + lz->blockPos, size);
+	lz->blockPos += size;
+	return size;
+}
+
+/* write() for compressed streams, which fills the block and writes it out as a frame once it's full. *\
+\* Returns 1 on failure                                                                                 */
+static int plFLZWrite(plflz_t* lz, const byte_t* data, size_t size){
+	if(!lz->isWrite){
+		errno = EBADF;
+		return 1;
+	}
 
-		memcpy(string, stream->strbuf + stream->seekbyte, writeNum);
-		string[writeNum] = '\n';
+	while(size > 0){
+		size_t copySize = PLF_LZ_BLOCKSIZE - lz->blockSize;
+		if(copySize > size)
+			copySize = size;
 
-		if(stream->seekbyte + writeNum + 1 > stream->bufsize){
-			stream->seekbyte = stream->bufsize - 1;
-		}else{
-			stream->seekbyte += (writeNum + 1);
+		memcpy(lz->block + lz->blockSize, data, copySize);
+		lz->blockSize += copySize;
+		data += copySize;
+		size -= copySize;
+
+		if(lz->blockSize == PLF_LZ_BLOCKSIZE && plFLZWriteFrame(lz))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* lseek() for compressed streams. Reads can seek anywhere, only decompressing the frame that holds *\
+|* the new position thanks to the frame index, while writes can only tell where they are. Returns  *|
+\* the new position, or -1 on failure                                                              */
+static off_t plFLZSeek(plflz_t* lz, off_t offset, int whence){
+	size_t basePos;
+
+	if(lz->isWrite){
+		if(offset != 0 || whence < SEEK_SET || whence > SEEK_END){
+			errno = EINVAL;
+			return -1;
 		}
 
-		return string;
-	}else{
-		return fgets(string, num, stream->fileptr);
+		return lz->blockOffset + lz->blockSize;
+	}
+
+	switch(whence){
+		case SEEK_SET:
+			basePos = 0;
+			break;
+		case SEEK_CUR:
+			basePos = lz->blockOffset + lz->blockPos;
+			break;
+		case SEEK_END:
+			errno = 0;
+			if(plFLZFindFrame(lz, lz->indexSize - 1, lz->index[lz->indexSize - 1], 0, true) && errno == EIO)
+				return -1;
+
+			basePos = lz->blockOffset;
+			break;
+		default:
+			errno = EINVAL;
+			return -1;
+	}
+
+	if(offset < 0 && (size_t)-offset > basePos){
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t target = basePos + offset;
+	if(target >= lz->blockOffset && target <= lz->blockOffset + lz->blockSize){
+		lz->blockPos = target - lz->blockOffset;
+		return target;
+	}
+
+	/* Finds the last indexed frame that starts at or before target */
+	size_t low = 0;
+	size_t high = lz->indexSize;
+	while(high - low > 1){
+		size_t middle = low + (high - low) / 2;
+
+		if(lz->index[middle].rawOffset <= target)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	if(plFLZFindFrame(lz, low, lz->index[low], target, false)){
+		errno = EINVAL;
+		return -1;
 	}
+
+	return target;
 }
 
-/* Moves the seek position offset amount of bytes relative from whence */
-int plFSeek(plfile_t* stream, long int offset, int whence){
-	if(stream == NULL)
+/* Writes out the last frame of a compressed stream and frees its filter. Returns 1 on failure */
+static int plFLZStop(plfile_t* stream){
+	plflz_t* lz = stream->filter;
+	plmt_t* mt = lz->base->mtptr;
+	int retVar = 0;
+
+	if(lz->isWrite && (plFLZWriteFrame(lz) || plFFlush(lz->base)))
+		retVar = 1;
+	if(lz->closeBase && plFClose(lz->base))
+		retVar = 1;
+
+	plMTFree(mt, lz->block);
+	plMTFree(mt, lz->packed);
+	if(lz->index != NULL)
+		plMTFree(mt, lz->index);
+
+	plMTFree(mt, lz);
+	stream->filter = NULL;
+	return retVar;
+}
+
+/* Sleeps until the other end of a pipe bumps seq, unless count has already moved past oldCount or *\
+|* the other end has closed. Both are checked after announcing the wait, and the other end checks  *|
+\* for waiters after moving its count or closing, so one of them always sees the other            */
+static void plFPipeWait(uint32_t* seq, bool* isWaiting, size_t* count, size_t oldCount, bool* isClosed){
+	uint32_t oldSeq = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+
+	__atomic_store_n(isWaiting, true, __ATOMIC_SEQ_CST);
+	if(__atomic_load_n(count, __ATOMIC_SEQ_CST) == oldCount && !__atomic_load_n(isClosed, __ATOMIC_SEQ_CST)){
+#ifdef __linux__
+		syscall(SYS_futex, seq, FUTEX_WAIT_PRIVATE, oldSeq, NULL, NULL, 0);
+#else
+		sched_yield();
+#endif
+	}
+
+	__atomic_store_n(isWaiting, false, __ATOMIC_RELAXED);
+}
+
+/* Wakes up the other end of a pipe if it's waiting on seq */
+static void plFPipeWake(uint32_t* seq, bool* isWaiting){
+	if(!__atomic_load_n(isWaiting, __ATOMIC_SEQ_CST))
+		return;
+
+	__atomic_add_fetch(seq, 1, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+	syscall(SYS_futex, seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+/* Reads up to size bytes out of the ring of a pipe, waiting for the write end if the ring is empty *\
+|* and the read end blocks. Returns the amount of bytes read, 0 once the write end is closed and the *|
+\* ring is empty, or -1 with errno set to EAGAIN if the read end would have to wait                 */
+static ssize_t plFPipeRead(plfile_t* stream, byte_t* dest, size_t size){
+	plfpipe_t* ring = stream->pipe;
+	size_t readCount = ring->readCount;
+
+	if(stream != ring->readEnd){
+		errno = EBADF;
+		return -1;
+	}
+
+	/* The closed flag is loaded first, so bytes committed right before closing can't be missed */
+	while(ring->cachedWriteCount == readCount){
+		bool isClosed = __atomic_load_n(&ring->isWriterClosed, __ATOMIC_ACQUIRE);
+
+		ring->cachedWriteCount = __atomic_load_n(&ring->writeCount, __ATOMIC_ACQUIRE);
+		if(ring->cachedWriteCount != readCount)
+			break;
+		if(isClosed)
+			return 0;
+
+		if(!ring->isReadBlocking){
+			errno = EAGAIN;
+			return -1;
+		}
+
+		plFPipeWait(&ring->dataSeq, &ring->isReaderWaiting, &ring->writeCount, readCount, &ring->isWriterClosed);
+	}
+
+	size_t availSize = ring->cachedWriteCount - readCount;
+	if(size > availSize)
+		size = availSize;
+
+	size_t offset = readCount & (ring->capacity - 1);
+	size_t firstSize = (size < ring->capacity - offset) ? size : ring->capacity - offset;
+
+	memcpy(dest, ring->ring + offset, firstSize);
+	memcpy(dest + firstSize, ring->ring, size - firstSize);
+	__atomic_store_n(&ring->readCount, readCount + size, __ATOMIC_SEQ_CST);
+	plFPipeWake(&ring->spaceSeq, &ring->isWriterWaiting);
+	return size;
+}
+
+/* Commits size bytes into the ring of a pipe, waiting for the read end to make room if the write *\
+|* end blocks. Otherwise nothing gets written unless all of it fits, and errno is set to EAGAIN.  *|
+\* Fails with errno set to EPIPE once the read end is closed. Returns 1 on failure                */
+static int plFPipeWrite(plfile_t* stream, const byte_t* data, size_t size){
+	plfpipe_t* ring = stream->pipe;
+	size_t writeCount = ring->writeCount;
+
+	if(stream != ring->writeEnd){
+		errno = EBADF;
 		return 1;
+	}
 
-	if(stream->fileptr == NULL){
-		switch(whence){
-			case SEEK_SET:
-				if(offset < stream->bufsize){
-					stream->seekbyte = offset;
-				}else{
-					return 1;
-				}
-				break;
-			case SEEK_CUR:
-				if(stream->seekbyte + offset < stream->bufsize){
-					stream->seekbyte += offset;
-				}else{
-					return 1;
-				}
-				break;
-			case SEEK_END:
-				if(stream->bufsize - offset >= 0){
-					stream->seekbyte = stream->bufsize - offset;
-				}else{
-					return 1;
-				}
-				break;
-			default:
-				return 1;
+	if(!ring->isWriteBlocking && size > ring->capacity - (writeCount - ring->cachedReadCount)){
+		ring->cachedReadCount = __atomic_load_n(&ring->readCount, __ATOMIC_ACQUIRE);
+		if(size > ring->capacity - (writeCount - ring->cachedReadCount)){
+			errno = EAGAIN;
+			return 1;
 		}
+	}
 
-		return 0;
-	}else{
-		return fseek(stream->fileptr, offset, whence);
+	while(size > 0){
+		if(__atomic_load_n(&ring->isReaderClosed, __ATOMIC_ACQUIRE)){
+			errno = EPIPE;
+			return 1;
+		}
+
+		size_t freeSize = ring->capacity - (writeCount - ring->cachedReadCount);
+		if(freeSize == 0){
+			ring->cachedReadCount = __atomic_load_n(&ring->readCount, __ATOMIC_ACQUIRE);
+			if(writeCount - ring->cachedReadCount == ring->capacity)
+				plFPipeWait(&ring->spaceSeq, &ring->isWriterWaiting, &ring->readCount, ring->cachedReadCount, &ring->isReaderClosed);
+
+			continue;
+		}
+
+		size_t chunkSize = (size < freeSize) ? size : freeSize;
+		size_t offset = writeCount & (ring->capacity - 1);
+		size_t firstSize = (chunkSize < ring->capacity - offset) ? chunkSize : ring->capacity - offset;
+
+		memcpy(ring->ring + offset, data, firstSize);
+		memcpy(ring->ring, data + firstSize, chunkSize - firstSize);
+		writeCount += chunkSize;
+		__atomic_store_n(&ring->writeCount, writeCount, __ATOMIC_SEQ_CST);
+		plFPipeWake(&ring->dataSeq, &ring->isReaderWaiting);
+
+		data += chunkSize;
+		size -= chunkSize;
 	}
+
+	return 0;
 }
 
-/* Tells you the current seek position */
-size_t plFTell(plfile_t* stream){
-	if(stream == NULL)
-		return 0;
+/* Closes one end of a pipe, waking up the other one. The last end to close frees the ring */
+static void plFPipeStop(plfile_t* stream){
+	plfpipe_t* ring = stream->pipe;
 
-	if(stream->fileptr == NULL){
-		return stream->seekbyte;
+	if(stream == ring->writeEnd){
+		__atomic_store_n(&ring->isWriterClosed, true, __ATOMIC_SEQ_CST);
+		plFPipeWake(&ring->dataSeq, &ring->isReaderWaiting);
 	}else{
-		fflush(stream->fileptr);
-		return ftell(stream->fileptr);
+		__atomic_store_n(&ring->isReaderClosed, true, __ATOMIC_SEQ_CST);
+		plFPipeWake(&ring->spaceSeq, &ring->isWriterWaiting);
+	}
+
+	stream->pipe = NULL;
+	if(__atomic_sub_fetch(&ring->openEnds, 1, __ATOMIC_ACQ_REL) == 0){
+		plMTFree(stream->mtptr, ring->ring);
+		plMTFree(stream->mtptr, ring);
 	}
 }
 
-/* Converts a memory buffer into a physical file */
-int plFPToFile(string_t filename, plfile_t* stream){
-	if(stream == NULL || filename == NULL || stream->strbuf == NULL)
-		plPanic("plFPToFile: Stream, filename and/or byte buffer is NULL", false, true);
+/* Reads up to size bytes through the FILE pointer of a stream made by plFToP. fread waits until it has *\
+|* every byte asked for, so FILE pointers that aren't regular files stop after a line instead. Returns *|
+\* the amount of bytes read, 0 at the end of file, or -1 on failure                                     */
+static ssize_t plFStdioRead(plfile_t* stream, byte_t* dest, size_t size){
+	FILE* pointer = stream->fileptr;
+	size_t readSize = 0;
 
-	FILE* realFile = fopen(filename, "w");
-	if(realFile == NULL)
-		plPanic("plFPToFile", true, false);
+	/* Like read(), every call tries again after the end of file or an error */
+	clearerr(pointer);
+	if(!stream->isLineRead){
+		readSize = fread(dest, 1, size, pointer);
+	}else{
+		int ch = 0;
 
-	int retVar = fputs((string_t)stream->strbuf, realFile);
-	fclose(realFile);
-	return retVar;
+		flockfile(pointer);
+		while(readSize < size && ch != '\n' && (ch = getc_unlocked(pointer)) != EOF)
+			dest[readSize++] = ch;
+		funlockfile(pointer);
+	}
+
+	return (readSize == 0 && ferror(pointer)) ? -1 : (ssize_t)readSize;
 }
 
-/* Concatenates two files */
-void plFCat(plfile_t* dest, plfile_t* src, int destWhence, int srcWhence, bool closeSrc){
-	if(dest == NULL || src == NULL)
-		plPanic("plFCat: Destination and/or source stream is NULL", false, true);
+/* read() on an actual file, which goes through the filter of compressed streams, the ring of pipes *\
+\* or the FILE pointer of streams made by plFToP                                                     */
+static ssize_t plFSysRead(plfile_t* stream, byte_t* dest, size_t size){
+	if(stream->filter != NULL)
+		return plFLZRead(stream->filter, dest, size);
+	if(stream->pipe != NULL)
+		return plFPipeRead(stream, dest, size);
+	if(stream->fileptr != NULL)
+		return plFStdioRead(stream, dest, size);
+
+	return read(stream->fd, dest, size);
+}
+
+/* lseek() on an actual file, which goes through the filter of compressed streams or the FILE pointer *\
+\* of streams made by plFToP. Pipes can't seek                                                         */
+static off_t plFSysSeek(plfile_t* stream, off_t offset, int whence){
+	if(stream->filter != NULL)
+		return plFLZSeek(stream->filter, offset, whence);
+	if(stream->pipe != NULL){
+		errno = ESPIPE;
+		return -1;
+	}
+
+	/* Only asking for the position doesn't seek, which would throw away what the FILE pointer has read ahead */
+	if(stream->fileptr != NULL){
+		if((offset != 0 || whence != SEEK_CUR) && fseeko(stream->fileptr, offset, whence) == -1)
+			return -1;
+
+		return ftello(stream->fileptr);
+	}
+
+	return lseek(stream->fd, offset, whence);
+}
+
+/* Writes size bytes to an actual file, retrying on partial writes. Streams made by plFToP write *\
+\* through their FILE pointer and flush it, so the bytes reach the file. Returns 1 on failure    */
+static int plFWriteAll(plfile_t* stream, const byte_t* data, size_t size){
+	if(stream->filter != NULL)
+		return plFLZWrite(stream->filter, data, size);
+	if(stream->pipe != NULL)
+		return plFPipeWrite(stream, data, size);
+	if(stream->fileptr != NULL)
+		return fwrite(data, 1, size, stream->fileptr) != size || fflush(stream->fileptr) != 0;
+
+	while(size > 0){
+		ssize_t writtenSize = write(stream->fd, data, size);
+
+		if(writtenSize < 0){
+			if(errno == EINTR)
+				continue;
+
+			return 1;
+		}
+
+		data += writtenSize;
+		size -= writtenSize;
+	}
+
+	return 0;
+}
+
+/* Closes whichever buffer window is open. Files in memory store their seek position and length, *\
+|* actual files write out their buffer or give their unread bytes back to the file, so the file  *|
+\* offset matches what the caller has seen. Returns 1 if the buffer couldn't be written          */
+static int plFCloseWindow(plfile_t* stream){
+	plfilebuf_t* buf = &stream->buf;
+	int retVar = 0;
+
+	if(stream->fd == -1){
+		if(buf->readPos != NULL)
+			stream->seekbyte = buf->readPos - stream->strbuf;
+
+		if(buf->writePos != NULL){
+			stream->seekbyte = buf->writePos - stream->strbuf;
+			if(stream->seekbyte > stream->datasize)
+				stream->datasize = stream->seekbyte;
+		}
+	}else{
+		if(buf->writePos != NULL)
+			retVar = plFWriteAll(stream, stream->strbuf, buf->writePos - stream->strbuf);
+
+		if(buf->readPos < buf->readEnd)
+			plFSysSeek(stream, -(off_t)(buf->readEnd - buf->readPos), SEEK_CUR);
+		else if(buf->readPos != NULL && stream->fileptr != NULL)
+			fseeko(stream->fileptr, 0, SEEK_CUR); /* FILE pointers have to seek between reading and writing */
+	}
+
+	buf->readPos = NULL;
+	buf->readEnd = NULL;
+	buf->writePos = NULL;
+	buf->writeEnd = NULL;
+	return retVar;
+}
+
+/* Allocates the buffer of an actual file if it doesn't have one yet. Returns 1 on failure */
+static int plFAllocBuf(plfile_t* stream){
+	if(stream->strbuf == NULL)
+		stream->strbuf = plMTAlloc(stream->mtptr, stream->bufsize);
+
+	return stream->strbuf == NULL;
+}
+
+/* Background thread that prefetches the window in front of the caller whenever it gets close to its end */
+static void* plFReadaheadWorker(void* raPtr){
+	plfreadahead_t* ra = raPtr;
+
+	pthread_mutex_lock(&ra->lock);
+	while(true){
+		while(!ra->isRequested && !ra->isStopping)
+			pthread_cond_wait(&ra->cond, &ra->lock);
+
+		if(ra->isStopping)
+			break;
+
+		off_t startPos = (ra->donePos > ra->requestPos) ? ra->donePos : ra->requestPos;
+		off_t endPos = ra->requestPos + ra->windowSize;
+		ra->donePos = endPos;
+		ra->isRequested = false;
+
+		/* Reading the window for real keeps the kernel's own readahead going in front of this thread */
+		pthread_mutex_unlock(&ra->lock);
+		while(startPos < endPos){
+			size_t chunkSize = (endPos - startPos < PLF_READAHEAD_CHUNK) ? (size_t)(endPos - startPos) : PLF_READAHEAD_CHUNK;
+			ssize_t readSize = pread(ra->fd, ra->scratch, chunkSize, startPos);
+
+			if(readSize < 0 && errno == EINTR)
+				continue;
+			if(readSize <= 0)
+				break;
+
+			startPos += readSize;
+		}
+		pthread_mutex_lock(&ra->lock);
+	}
+	pthread_mutex_unlock(&ra->lock);
+
+	return NULL;
+}
+
+/* Tells the readahead thread how far the file has been read. It only gets woken up once the *\
+\* caller is past the middle of the prefetched window, or has seeked back before it           */
+static void plFReadaheadNotify(plfile_t* stream){
+	plfreadahead_t* ra = stream->readahead;
+	off_t filePos = plFSysSeek(stream, 0, SEEK_CUR);
+
+	if(filePos < 0)
+		return;
+
+	pthread_mutex_lock(&ra->lock);
+	if(filePos < ra->requestPos)
+		ra->donePos = filePos;
+
+	ra->requestPos = filePos;
+	if(filePos + (off_t)(ra->windowSize / 2) >= ra->donePos){
+		ra->isRequested = true;
+		pthread_cond_signal(&ra->cond);
+	}
+	pthread_mutex_unlock(&ra->lock);
+}
+
+/* Stops the readahead thread of an actual file */
+static void plFReadaheadStop(plfile_t* stream){
+	plfreadahead_t* ra = stream->readahead;
+
+	pthread_mutex_lock(&ra->lock);
+	ra->isStopping = true;
+	pthread_cond_signal(&ra->cond);
+	pthread_mutex_unlock(&ra->lock);
+
+	pthread_join(ra->thread, NULL);
+	pthread_cond_destroy(&ra->cond);
+	pthread_mutex_destroy(&ra->lock);
+	plMTFree(stream->mtptr, ra->scratch);
+	plMTFree(stream->mtptr, ra);
+	stream->readahead = NULL;
+}
+
+/* Opens the read window, refilling the buffer of actual files once it has been read *\
+\* completely. Returns the amount of bytes that can be read, or 0 at the end of file  */
+static size_t plFFillRead(plfile_t* stream){
+	plfilebuf_t* buf = &stream->buf;
+
+	if(buf->readPos == NULL){
+		if(plFCloseWindow(stream))
+			return 0;
+
+		if(stream->fd == -1){
+			if(stream->strbuf == NULL)
+				return 0;
+
+			buf->readPos = stream->strbuf + stream->seekbyte;
+			buf->readEnd = stream->strbuf + stream->datasize;
+			return buf->readEnd - buf->readPos;
+		}
+
+		if(plFAllocBuf(stream))
+			return 0;
+	}else if(buf->readPos < buf->readEnd || stream->fd == -1){
+		return buf->readEnd - buf->readPos;
+	}
+
+	ssize_t readSize;
+	do{
+		readSize = plFSysRead(stream, stream->strbuf, stream->bufsize);
+	}while(readSize < 0 && errno == EINTR);
+
+	if(stream->readahead != NULL)
+		plFReadaheadNotify(stream);
+
+	buf->readPos = stream->strbuf;
+	buf->readEnd = stream->strbuf + ((readSize > 0) ? readSize : 0);
+	return buf->readEnd - buf->readPos;
+}
+
+/* Opens the read window and tries to get at least size bytes into it. Actual files move their *\
+|* unread bytes to the start of the buffer and read in behind them, up to the buffer size.     *|
+\* Returns the amount of bytes that can be read                                                */
+static size_t plFFillPeek(plfile_t* stream, size_t size){
+	plfilebuf_t* buf = &stream->buf;
+	size_t availSize = plFFillRead(stream);
+
+	if(stream->fd == -1 || availSize == 0 || availSize >= size)
+		return availSize;
+
+	if(size > stream->bufsize)
+		size = stream->bufsize;
+
+	memmove(stream->strbuf, buf->readPos, availSize);
+	buf->readPos = stream->strbuf;
+	buf->readEnd = stream->strbuf + availSize;
+
+	while(availSize < size){
+		ssize_t readSize = plFSysRead(stream, buf->readEnd, stream->bufsize - availSize);
+
+		if(readSize < 0 && errno == EINTR)
+			continue;
+		if(readSize <= 0)
+			break;
+
+		buf->readEnd += readSize;
+		availSize += readSize;
+	}
+
+	if(stream->readahead != NULL)
+		plFReadaheadNotify(stream);
+
+	return availSize;
+}
+
+/* Doubles the buffer of an actual file so a line longer than it can fit, keeping the read *\
+\* window open. Returns 1 on failure                                                        */
+static int plFGrowBuf(plfile_t* stream){
+	plfilebuf_t* buf = &stream->buf;
+	byte_t* tempPtr = plMTRealloc(stream->mtptr, stream->strbuf, stream->bufsize * 2);
+
+	if(tempPtr == NULL)
+		return 1;
+
+	buf->readPos = tempPtr + (buf->readPos - stream->strbuf);
+	buf->readEnd = tempPtr + (buf->readEnd - stream->strbuf);
+	stream->strbuf = tempPtr;
+	stream->bufsize *= 2;
+	return 0;
+}
+
+/* Grows the contents of a file in memory so they can hold capacity bytes. Doesn't move the *\
+\* buffer window, so it must be closed or moved by the caller. Returns 1 on failure          */
+static int plFMemReserve(plfile_t* stream, size_t capacity){
+	if(capacity <= stream->bufsize)
+		return 0;
+
+	byte_t* tempPtr = (stream->strbuf == NULL) ? plMTAlloc(stream->mtptr, capacity) : plMTRealloc(stream->mtptr, stream->strbuf, capacity);
+	if(tempPtr == NULL)
+		return 1;
+
+	stream->strbuf = tempPtr;
+	stream->bufsize = capacity;
+	return 0;
+}
+
+/* Writes out the buffer of an actual file, keeping the write window open. Returns 1 on failure */
+static int plFWriteBuf(plfile_t* stream){
+	plfilebuf_t* buf = &stream->buf;
+
+	if(stream->fd == -1 || buf->writePos == NULL)
+		return 0;
+
+	size_t size = buf->writePos - stream->strbuf;
+	int retVar = plFWriteAll(stream, stream->strbuf, size);
+
+	/* Pipes that would have to wait don't write anything, so their buffer is kept for the next try */
+	if(retVar == 0 || stream->pipe == NULL || errno != EAGAIN)
+		buf->writePos = stream->strbuf;
+
+	return retVar;
+}
+
+/* Whether a failed flush left the buffer of a non-blocking pipe for later, which isn't an error */
+static bool plFIsDeferred(plfile_t* stream){
+	return stream->pipe != NULL && errno == EAGAIN && stream->buf.writePos != stream->strbuf;
+}
+
+/* Moves the contents of a file in memory into an anonymous temporary file, turning it into an *\
+|* actual file at the same seek position. The file is created with O_TMPFILE, or removed right *|
+\* after it's created if O_TMPFILE isn't supported. Returns 1 on failure                        */
+static int plFSpill(plfile_t* stream){
+	string_t tmpDir = getenv("TMPDIR");
+	int fd = -1;
+
+	if(plFCloseWindow(stream))
+		return 1;
+
+	if(tmpDir == NULL || tmpDir[0] == '\0')
+		tmpDir = "/tmp";
+
+#ifdef O_TMPFILE
+	fd = open(tmpDir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+#endif
+	if(fd == -1){
+		char path[PATH_MAX];
+
+		if(snprintf(path, PATH_MAX, "%s/pl32-spill-XXXXXX", tmpDir) >= PATH_MAX || (fd = mkstemp(path)) == -1)
+			return 1;
+
+		unlink(path);
+	}
+
+	stream->fd = fd;
+	if(plFWriteAll(stream, stream->strbuf, stream->datasize) || lseek(fd, stream->seekbyte, SEEK_SET) == -1){
+		close(fd);
+		stream->fd = -1;
+		return 1;
+	}
+
+	if(stream->strbuf != NULL)
+		plMTFree(stream->mtptr, stream->strbuf);
+
+	stream->strbuf = NULL;
+	stream->seekbyte = 0;
+	stream->bufsize = PLF_BUFSIZE;
+	stream->datasize = 0;
+	stream->isSpilled = true;
+	return 0;
+}
+
+/* Opens the write window and makes room for size bytes. Files in memory grow to at least twice  *\
+|* their size to fit them, while actual files flush their buffer if they don't fit. Returns the  *|
+|* amount of bytes that can be written without a flush, which is always 0 for files that use    *|
+\* PLF_FLUSH_NONE                                                                                */
+static size_t plFFillWrite(plfile_t* stream, size_t size){
+	plfilebuf_t* buf = &stream->buf;
+
+	if(buf->writePos == NULL){
+		if(stream->isMapped || plFCloseWindow(stream))
+			return 0;
+
+		if(stream->fd == -1){
+			size_t firstSize = (size > PLF_MEMSIZE) ? size : PLF_MEMSIZE;
+
+			/* Streams that spill move into a temporary file once a write doesn't fit under their spill size */
+			if(stream->spillSize != 0){
+				if(firstSize > stream->spillSize)
+					firstSize = stream->spillSize;
+
+				if(stream->seekbyte > stream->spillSize || size > stream->spillSize - stream->seekbyte || (stream->strbuf == NULL && plFMemReserve(stream, firstSize)))
+					return plFSpill(stream) ? 0 : plFFillWrite(stream, size);
+			}
+
+			if(stream->strbuf == NULL && plFMemReserve(stream, firstSize))
+				return 0;
+
+			buf->writePos = stream->strbuf + stream->seekbyte;
+			buf->writeEnd = stream->strbuf + stream->bufsize;
+		}else{
+			if(plFAllocBuf(stream))
+				return 0;
+
+			buf->writePos = stream->strbuf;
+			buf->writeEnd = stream->strbuf + ((stream->flushMode == PLF_FLUSH_NONE) ? 0 : stream->bufsize);
+		}
+	}
+
+	size_t space = buf->writeEnd - buf->writePos;
+	if(size <= space)
+		return space;
+
+	if(stream->fd == -1){
+		size_t seekbyte = buf->writePos - stream->strbuf;
+		size_t capacity = (stream->bufsize <= SIZE_MAX / 2) ? stream->bufsize * 2 : SIZE_MAX;
+
+		if(size > SIZE_MAX - seekbyte)
+			return space;
+		if(capacity < seekbyte + size)
+			capacity = seekbyte + size;
+
+		/* Streams that spill never grow past their spill size, and also spill if the memory tracker runs out */
+		if(stream->spillSize != 0){
+			if(capacity > stream->spillSize)
+				capacity = stream->spillSize;
+
+			if(seekbyte + size > capacity || (plFMemReserve(stream, capacity) && plFMemReserve(stream, seekbyte + size)))
+				return plFSpill(stream) ? space : plFFillWrite(stream, size);
+		}
+
+		/* Fall back to an exact fit if doubling doesn't fit in the memory tracker */
+		if(plFMemReserve(stream, capacity) && plFMemReserve(stream, seekbyte + size))
+			return space;
+
+		buf->writePos = stream->strbuf + seekbyte;
+		buf->writeEnd = stream->strbuf + stream->bufsize;
+	}else if(buf->writePos != stream->strbuf){
+		if(plFWriteBuf(stream))
+			return 0;
+	}
+
+	return buf->writeEnd - buf->writePos;
+}
+
+/* Writes size bytes into the file stream, bypassing the buffer if they don't fit in it. *\
+\* Returns the amount of bytes written                                                    */
+static size_t plFWriteBytes(plfile_t* stream, const byte_t* data, size_t size){
+	plfilebuf_t* buf = &stream->buf;
+	size_t space = plFFillWrite(stream, size);
+
+	if(buf->writePos == NULL)
+		return 0;
+
+	if(size <= space){
+		memcpy(buf->writePos, data, size);
+		buf->writePos += size;
+	}else if(stream->fd == -1){
+		memcpy(buf->writePos, data, space);
+		buf->writePos += space;
+		return space;
+	}else if(buf->writePos != stream->strbuf || plFWriteAll(stream, data, size)){
+		/* Bytes still in the buffer have to go out first */
+		return 0;
+	}
+
+	if(stream->flushMode == PLF_FLUSH_LINE && stream->fd != -1 && memchr(data, '\n', size) != NULL && plFFlush(stream) && !plFIsDeferred(stream))
+		return 0;
+
+	return size;
+}
+
+/* Maps a regular file into memory and closes its file descriptor. The mapping gets charged to the *\
+|* memory tracker. Returns NULL if the file can't be mapped or the mapping doesn't fit in the      *|
+\* memory tracker, in which case the file descriptor is left open                                  */
+static plfile_t* plFMapFile(int fd, plmt_t* mt){
+	struct stat fileInfo;
+
+	if(fstat(fd, &fileInfo) == -1 || !S_ISREG(fileInfo.st_mode) || fileInfo.st_size <= 0 || (uintmax_t)fileInfo.st_size > SIZE_MAX)
+		return NULL;
+
+	size_t mapSize = fileInfo.st_size;
+	if(plMTChargeExternal(mt, mapSize))
+		return NULL;
+
+	byte_t* mapping = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(mapping == MAP_FAILED){
+		plMTUnchargeExternal(mt, mapSize);
+		return NULL;
+	}
+
+	plfile_t* returnStruct = plFInitFile(-1, mt);
+
+	close(fd);
+	returnStruct->strbuf = mapping;
+	returnStruct->bufsize = mapSize;
+	returnStruct->datasize = mapSize;
+	returnStruct->isMapped = true;
+	return returnStruct;
+}
+
+/* Opens a file stream. If filename is NULL, a file-in-memory is returned */
+plfile_t* plFOpen(string_t filename, string_t mode, plmt_t* mt){
+	if(mt == NULL)
+		plPanic("plFOpen: Memory tracker was set to NULL", false, true);
+
+	/* If no filename is given, set up a file in memory. Its contents get allocated on the first write */
+	if(filename == NULL){
+		plfile_t* returnStruct = plFInitFile(-1, mt);
+
+		returnStruct->bufsize = 0;
+		return returnStruct;
+	}
+
+	if(mode == NULL)
+		plPanic("plFOpen: File mode was set to NULL", false, true);
+
+	int flags = plFModeFlags(mode);
+	int fd = -1;
+
+	if(flags == -1)
+		errno = EINVAL;
+	else
+		fd = open(filename, flags, 0666);
+
+	if(fd == -1)
+		plPanic("plFOpen", true, false);
+
+	/* Read-only files opened with the m flag get mapped, unless they aren't regular files or don't fit in the memory tracker */
+	if(strchr(mode, 'm') != NULL && (flags & O_ACCMODE) == O_RDONLY){
+		plfile_t* mappedFile = plFMapFile(fd, mt);
+		if(mappedFile != NULL)
+			return mappedFile;
+	}
+
+	return plFInitFile(fd, mt);
+}
+
+/* Converts a FILE pointer into a plfile_t pointer. The stream reads and writes through pointer, *\
+\* so whatever pointer has buffered or had pushed back with ungetc stays valid                     */
+plfile_t* plFToP(FILE* pointer, string_t mode, plmt_t* mt){
+	if(pointer == NULL)
+		return NULL;
+
+	if(mt == NULL)
+		plPanic("plFToP: Memory tracker was set to NULL", false, true);
+
+	struct stat fileInfo;
+	plfile_t* returnPointer = plFInitFile(fileno(pointer), mt);
+
+	returnPointer->fileptr = pointer;
+	returnPointer->isLineRead = fstat(returnPointer->fd, &fileInfo) == -1 || !S_ISREG(fileInfo.st_mode);
+	return returnPointer;
+}
+
+/* Opens a compressed stream over base, which compresses everything written to it into frames of *\
+|* base, or decompresses the frames of base as it's read. mode is "r" or "w", and frames start at *|
+|* the current position of base, which must not be used directly until the compressed stream is  *|
+\* closed. closeBase closes base along with it. Returns NULL on failure                            */
+plfile_t* plFOpenCompressed(plfile_t* base, string_t mode, bool closeBase){
+	if(base == NULL || mode == NULL)
+		plPanic("plFOpenCompressed: Base stream and/or mode is NULL", false, true);
+
+	if((mode[0] != 'r' && mode[0] != 'w') || strchr(mode, '+') != NULL)
+		return NULL;
+
+	plmt_t* mt = base->mtptr;
+	plflz_t* lz = plMTAlloc(mt, sizeof(plflz_t));
+	if(lz == NULL)
+		return NULL;
+
+	plflzframe_t firstFrame = { 0, plFTell(base) };
+	lz->base = base;
+	lz->block = plMTAlloc(mt, PLF_LZ_BLOCKSIZE);
+	lz->packed = plMTAlloc(mt, PLF_LZ_BLOCKSIZE);
+	lz->blockPos = 0;
+	lz->blockSize = 0;
+	lz->blockOffset = 0;
+	lz->nextFrame = 0;
+	lz->nextFrameBase = firstFrame.baseOffset;
+	lz->basePos = firstFrame.baseOffset;
+	lz->index = NULL;
+	lz->indexSize = 0;
+	lz->indexCapacity = 0;
+	lz->isWrite = mode[0] == 'w';
+	lz->closeBase = closeBase;
+
+	/* Seeking from the end needs at least the first frame in the index */
+	plFLZAddFrame(lz, 0, firstFrame);
+	if(lz->block == NULL || lz->packed == NULL || lz->indexSize == 0){
+		plMTFree(mt, lz->block);
+		plMTFree(mt, lz->packed);
+		plMTFree(mt, lz->index);
+		plMTFree(mt, lz);
+		return NULL;
+	}
+
+	plfile_t* returnStruct = plFInitFile(PLF_FILTER_FD, mt);
+	returnStruct->filter = lz;
+	return returnStruct;
+}
+
+/* Opens a pipe with a ring buffer of at least capacity bytes, for passing data from one thread to *\
+|* another. ends[0] is the read end and ends[1] is the write end. Data written to the write end is  *|
+|* committed to the ring whenever its buffer gets flushed. isBlocking makes both ends wait for the *|
+|* other one when the ring is empty or full. The ends get closed and freed from whichever thread   *|
+\* is done with them, so mt has to be a shared memory tracker. Returns 1 on failure               */
+int plFPipe(plfile_t* ends[2], size_t capacity, bool isBlocking, plmt_t* mt){
+	if(ends == NULL || mt == NULL)
+		plPanic("plFPipe: Ends and/or memory tracker is NULL", false, true);
+
+	if(capacity == 0 || capacity > SIZE_MAX / 2 + 1 || !plMTIsShared(mt))
+		return 1;
+
+	size_t ringSize = 1;
+	while(ringSize < capacity)
+		ringSize *= 2;
+
+	plfpipe_t* ring = plMTAlloc(mt, sizeof(plfpipe_t));
+	if(ring == NULL)
+		return 1;
+
+	memset(ring, 0, sizeof(plfpipe_t));
+	ring->ring = plMTAlloc(mt, ringSize);
+	ring->capacity = ringSize;
+	ring->isReadBlocking = isBlocking;
+	ring->isWriteBlocking = isBlocking;
+	ring->openEnds = 2;
+	if(ring->ring == NULL){
+		plMTFree(mt, ring);
+		return 1;
+	}
+
+	ring->readEnd = plFInitFile(PLF_PIPE_FD, mt);
+	ring->writeEnd = plFInitFile(PLF_PIPE_FD, mt);
+	ring->readEnd->pipe = ring;
+	ring->writeEnd->pipe = ring;
+	if(ringSize < PLF_BUFSIZE)
+		ring->writeEnd->bufsize = ringSize;
+
+	/* The buffers are allocated up front, so a full memory tracker makes plFPipe fail instead of the first read or write */
+	if(plFAllocBuf(ring->readEnd) || plFAllocBuf(ring->writeEnd)){
+		plFClose(ring->readEnd);
+		plFClose(ring->writeEnd);
+		return 1;
+	}
+
+	ends[0] = ring->readEnd;
+	ends[1] = ring->writeEnd;
+	return 0;
+}
+
+/* Closes a file stream */
+int plFClose(plfile_t* ptr){
+	if(ptr == NULL)
+		return 1;
+
+	/* Non-blocking pipes still wait for room for the rest of their buffer */
+	if(ptr->pipe != NULL && ptr == ptr->pipe->writeEnd)
+		ptr->pipe->isWriteBlocking = true;
+
+	int retVar = plFCloseWindow(ptr);
+	if(ptr->readahead != NULL)
+		plFReadaheadStop(ptr);
+
+	if(ptr->filter != NULL){
+		if(plFLZStop(ptr))
+			retVar = 1;
+	}else if(ptr->pipe != NULL){
+		plFPipeStop(ptr);
+	}else if(ptr->fileptr != NULL){
+		if(fclose(ptr->fileptr))
+			retVar = 1;
+	}else if(ptr->fd != -1){
+		if(close(ptr->fd))
+			retVar = 1;
+	}
+
+	if(ptr->isMapped){
+		munmap(ptr->strbuf, ptr->bufsize);
+		plMTUnchargeExternal(ptr->mtptr, ptr->bufsize);
+	}else if(ptr->strbuf != NULL){
+		plMTFree(ptr->mtptr, ptr->strbuf);
+	}
+
+	plMTFree(ptr->mtptr, ptr);
+	return retVar;
+}
+
+/* Sets the buffer size of an actual file and when its buffer gets flushed. A size of 0 keeps *\
+\* the current buffer size. Files in memory don't have a separate buffer. Returns 1 on failure */
+int plFSetBuf(plfile_t* stream, size_t size, plfflush_t flushMode){
+	if(stream == NULL || stream->fd == -1 || flushMode > PLF_FLUSH_NONE)
+		return 1;
+
+	/* The buffer of the write end of a pipe has to fit in the pipe */
+	if(stream->pipe != NULL && stream == stream->pipe->writeEnd && size > stream->pipe->capacity)
+		return 1;
+
+	if(plFCloseWindow(stream))
+		return 1;
+
+	if(size != 0 && size != stream->bufsize){
+		if(stream->strbuf != NULL)
+			plMTFree(stream->mtptr, stream->strbuf);
+
+		stream->strbuf = NULL;
+		stream->bufsize = size;
+	}
+
+	stream->flushMode = flushMode;
+	stream->buf.isLineFlushed = flushMode == PLF_FLUSH_LINE;
+	return 0;
+}
+
+/* Makes sure a file in memory can hold capacity bytes without growing. Returns 1 on failure, *\
+\* which includes a capacity past the spill size of the file                                 */
+int plFReserve(plfile_t* stream, size_t capacity){
+	if(stream == NULL || stream->fd != -1 || stream->isMapped || (stream->spillSize != 0 && capacity > stream->spillSize) || plFCloseWindow(stream))
+		return 1;
+
+	return plFMemReserve(stream, capacity);
+}
+
+/* Shrinks the contents of a file in memory down to its length. Returns 1 on failure */
+int plFShrink(plfile_t* stream){
+	if(stream == NULL || stream->fd != -1 || stream->isMapped || plFCloseWindow(stream))
+		return 1;
+
+	if(stream->datasize == stream->bufsize)
+		return 0;
+
+	if(stream->datasize == 0){
+		plMTFree(stream->mtptr, stream->strbuf);
+		stream->strbuf = NULL;
+		stream->bufsize = 0;
+		return 0;
+	}
+
+	byte_t* tempPtr = plMTRealloc(stream->mtptr, stream->strbuf, stream->datasize);
+	if(tempPtr == NULL)
+		return 1;
+
+	stream->strbuf = tempPtr;
+	stream->bufsize = stream->datasize;
+	return 0;
+}
+
+/* Makes a file in memory move its contents into an anonymous temporary file once it would grow *\
+|* past spillSize bytes, after which it keeps working as an actual file. A spillSize of 0 keeps  *|
+\* it in memory. Returns 1 on failure                                                            */
+int plFSetSpill(plfile_t* stream, size_t spillSize){
+	if(stream == NULL || stream->fd != -1 || stream->isMapped || plFCloseWindow(stream))
+		return 1;
+
+	stream->spillSize = spillSize;
+	if(spillSize != 0 && (stream->datasize > spillSize || stream->bufsize > spillSize))
+		return plFSpill(stream);
+
+	return 0;
+}
+
+/* Tells the kernel how the file stream is going to be accessed, with posix_fadvise for actual *\
+\* files and madvise for mapped files. Files in memory ignore it. Returns 1 on failure           */
+int plFAdvise(plfile_t* stream, plfadvice_t advice){
+	static const int fileAdvice[5] = { POSIX_FADV_NORMAL, POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED };
+	static const int mapAdvice[5] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED, MADV_DONTNEED };
+
+	if(stream == NULL || advice > PLF_ADVISE_DONTNEED)
+		return 1;
+
+	if(stream->filter != NULL)
+		return plFAdvise(stream->filter->base, advice);
+
+	if(stream->isMapped)
+		return stream->bufsize != 0 && madvise(stream->strbuf, stream->bufsize, mapAdvice[advice]) != 0;
+
+	if(stream->fd == -1)
+		return 0;
+
+	return posix_fadvise(stream->fd, 0, 0, fileAdvice[advice]) != 0;
+}
+
+/* Starts a background thread that keeps windowSize bytes in front of the reads of an actual file *\
+|* in the page cache, so the caller doesn't wait for the disk while it processes what it read.    *|
+\* A windowSize of 0 stops the thread. Returns 1 on failure                                        */
+int plFSetReadahead(plfile_t* stream, size_t windowSize){
+	if(stream == NULL || stream->fd == -1 || stream->filter != NULL || stream->pipe != NULL)
+		return 1;
+
+	if(stream->readahead != NULL){
+		if(windowSize == 0){
+			plFReadaheadStop(stream);
+			return 0;
+		}
+
+		pthread_mutex_lock(&stream->readahead->lock);
+		stream->readahead->windowSize = windowSize;
+		pthread_mutex_unlock(&stream->readahead->lock);
+		return 0;
+	}
+
+	if(windowSize == 0)
+		return 0;
+
+	plfreadahead_t* ra = plMTAlloc(stream->mtptr, sizeof(plfreadahead_t));
+	if(ra == NULL)
+		return 1;
+
+	ra->scratch = plMTAlloc(stream->mtptr, PLF_READAHEAD_CHUNK);
+	if(ra->scratch == NULL){
+		plMTFree(stream->mtptr, ra);
+		return 1;
+	}
+
+	ra->fd = stream->fd;
+	ra->windowSize = windowSize;
+	ra->requestPos = 0;
+	ra->donePos = 0;
+	ra->isRequested = false;
+	ra->isStopping = false;
+	if(pthread_mutex_init(&ra->lock, NULL) || pthread_cond_init(&ra->cond, NULL) || pthread_create(&ra->thread, NULL, plFReadaheadWorker, ra)){
+		plMTFree(stream->mtptr, ra->scratch);
+		plMTFree(stream->mtptr, ra);
+		return 1;
+	}
+
+	stream->readahead = ra;
+	plFReadaheadNotify(stream);
+	return 0;
+}
+
+/* Writes out the buffer of an actual file. Compressed streams also write out their last frame *\
+\* and flush the stream below them. Returns 1 on failure                                        */
+int plFFlush(plfile_t* stream){
+	if(stream == NULL)
+		return 1;
+
+	if(plFWriteBuf(stream))
+		return 1;
+
+	if(stream->filter != NULL && stream->filter->isWrite)
+		return plFLZWriteFrame(stream->filter) || plFFlush(stream->filter->base);
+
+	return 0;
+}
+
+/* Reads size * nmemb amount of bytes from the file stream. Returns the amount of elements read */
+size_t plFRead(void* ptr, size_t size, size_t nmemb, plfile_t* stream){
+	if(stream == NULL || ptr == NULL || size == 0 || nmemb > SIZE_MAX / size)
+		return 0;
+
+	plfilebuf_t* buf = &stream->buf;
+	byte_t* dest = ptr;
+	size_t totalSize = size * nmemb;
+	size_t readSize = 0;
+
+	while(readSize < totalSize){
+		size_t leftSize = totalSize - readSize;
+		size_t availSize = buf->readEnd - buf->readPos;
+
+		if(availSize == 0){
+			/* Reads bigger than the buffer skip it once it's empty */
+			if(stream->fd != -1 && buf->readPos != NULL && leftSize >= stream->bufsize){
+				ssize_t directSize = plFSysRead(stream, dest + readSize, leftSize);
+
+				if(directSize < 0 && errno == EINTR)
+					continue;
+				if(directSize <= 0)
+					break;
+
+				readSize += directSize;
+				if(stream->readahead != NULL)
+					plFReadaheadNotify(stream);
+				continue;
+			}
+
+			if((availSize = plFFillRead(stream)) == 0)
+				break;
+		}
+
+		if(availSize > leftSize)
+			availSize = leftSize;
+
+		memcpy(dest + readSize, buf->readPos, availSize);
+		buf->readPos += availSize;
+		readSize += availSize;
+	}
+
+	return readSize / size;
+}
+
+/* Writes size * nmemb amount of bytes to the file stream. Returns the amount of elements written */
+size_t plFWrite(void* ptr, size_t size, size_t nmemb, plfile_t* stream){
+	if(stream == NULL || ptr == NULL || size == 0 || nmemb > SIZE_MAX / size)
+		return 0;
+
+	return plFWriteBytes(stream, ptr, size * nmemb) / size;
+}
+
+/* Writes every iovec out with writev, retrying on partial writes. Returns 1 on failure */
+static int plFWritevAll(int fd, struct iovec* iov, int iovAmnt){
+	while(iovAmnt > 0){
+		ssize_t writtenSize = writev(fd, iov, iovAmnt);
+
+		if(writtenSize < 0){
+			if(errno == EINTR)
+				continue;
+
+			return 1;
+		}
+
+		while(iovAmnt > 0 && (size_t)writtenSize >= iov->iov_len){
+			writtenSize -= iov->iov_len;
+			iov++;
+			iovAmnt--;
+		}
+
+		if(iovAmnt > 0){
+			iov->iov_base = (byte_t*)iov->iov_base + writtenSize;
+			iov->iov_len -= writtenSize;
+		}
+	}
+
+	return 0;
+}
+
+/* Writes out the gathered iovecs of plFWritev followed by the rest of the buffer, then empties *\
+\* the buffer. Returns 1 on failure                                                              */
+static int plFWritevBuf(plfile_t* stream, struct iovec* iov, int* iovAmnt, byte_t** bufStart){
+	plfilebuf_t* buf = &stream->buf;
+
+	if(buf->writePos > *bufStart){
+		iov[*iovAmnt].iov_base = *bufStart;
+		iov[*iovAmnt].iov_len = buf->writePos - *bufStart;
+		(*iovAmnt)++;
+	}
+
+	int retVar = *iovAmnt != 0 && plFWritevAll(stream->fd, iov, *iovAmnt);
+
+	*iovAmnt = 0;
+	*bufStart = stream->strbuf;
+	buf->writePos = stream->strbuf;
+	return retVar;
+}
+
+/* Fills every piece in order, as if plFRead was called on each of them. Once the buffer of an  *\
+|* actual file runs out, reads bigger than it go straight into the pieces with a single readv. *|
+\* Returns the total amount of bytes read                                                        */
+size_t plFReadv(plfile_t* stream, const plarray_t* pieces, size_t pieceAmnt){
+	if(stream == NULL || pieces == NULL)
+		return 0;
+
+	plfilebuf_t* buf = &stream->buf;
+	size_t leftSize = 0;
+	size_t readSize = 0;
+	size_t pieceNum = 0;
+	size_t pieceOffset = 0;
+
+	for(size_t i = 0; i < pieceAmnt; i++)
+		leftSize += pieces[i].size;
+
+	while(leftSize > 0){
+		size_t availSize = buf->readEnd - buf->readPos;
+
+		if(availSize == 0){
+			if(stream->fd >= 0 && stream->fileptr == NULL && buf->readPos != NULL && leftSize >= stream->bufsize){
+				struct iovec iov[PLF_IOV_BATCH];
+				int iovAmnt = 0;
+
+				for(size_t i = pieceNum; i < pieceAmnt && iovAmnt < PLF_IOV_BATCH; i++){
+					size_t offset = (i == pieceNum) ? pieceOffset : 0;
+
+					if(pieces[i].size == offset)
+						continue;
+
+					iov[iovAmnt].iov_base = (byte_t*)pieces[i].array + offset;
+					iov[iovAmnt].iov_len = pieces[i].size - offset;
+					iovAmnt++;
+				}
+
+				ssize_t directSize = readv(stream->fd, iov, iovAmnt);
+				if(directSize < 0 && errno == EINTR)
+					continue;
+				if(directSize <= 0)
+					break;
+
+				readSize += directSize;
+				leftSize -= directSize;
+				while(directSize > 0){
+					size_t pieceLeft = pieces[pieceNum].size - pieceOffset;
+
+					if((size_t)directSize < pieceLeft){
+						pieceOffset += directSize;
+						break;
+					}
+
+					directSize -= pieceLeft;
+					pieceNum++;
+					pieceOffset = 0;
+				}
+
+				if(stream->readahead != NULL)
+					plFReadaheadNotify(stream);
+				continue;
+			}
+
+			if((availSize = plFFillRead(stream)) == 0)
+				break;
+		}
+
+		/* Copies what's in the buffer into as many pieces as it covers */
+		while(availSize > 0 && leftSize > 0){
+			size_t copySize = pieces[pieceNum].size - pieceOffset;
+			if(copySize > availSize)
+				copySize = availSize;
+
+			memcpy((byte_t*)pieces[pieceNum].array + pieceOffset, buf->readPos, copySize);
+			buf->readPos += copySize;
+			availSize -= copySize;
+			readSize += copySize;
+			leftSize -= copySize;
+			pieceOffset += copySize;
+
+			if(pieceOffset == pieces[pieceNum].size){
+				pieceNum++;
+				pieceOffset = 0;
+			}
+		}
+	}
+
+	return readSize;
+}
+
+/* Writes every piece in order, as if plFWrite was called on each of them. Files in memory grow once *\
+|* to fit all of them. Actual files copy small pieces into their buffer, and write big ones out     *|
+|* along with the buffer with a single writev. Returns the total amount of bytes written, or 0 on   *|
+\* failure                                                                                          */
+size_t plFWritev(plfile_t* stream, const plarray_t* pieces, size_t pieceAmnt){
+	if(stream == NULL || pieces == NULL)
+		return 0;
+
+	plfilebuf_t* buf = &stream->buf;
+	size_t totalSize = 0;
+
+	for(size_t i = 0; i < pieceAmnt; i++){
+		if(pieces[i].size > SIZE_MAX - totalSize)
+			return 0;
+
+		totalSize += pieces[i].size;
+	}
+
+	if(totalSize == 0)
+		return 0;
+
+	/* Compressed streams and pipes have no file descriptor to gather into, and streams made by plFToP go through their FILE pointer */
+	if(stream->fd < 0 || stream->fileptr != NULL){
+		if(plFFillWrite(stream, totalSize) < totalSize && stream->fd == -1)
+			return 0;
+
+		for(size_t i = 0; i < pieceAmnt; i++){
+			if(pieces[i].size != 0 && plFWriteBytes(stream, pieces[i].array, pieces[i].size) != pieces[i].size)
+				return 0;
+		}
+
+		return totalSize;
+	}
+
+	if(plFFillWrite(stream, 0) == 0 && buf->writePos == NULL)
+		return 0;
+
+	/* Copied pieces are gathered as a single iovec covering the part of the buffer they were copied into */
+	struct iovec iov[PLF_IOV_BATCH];
+	int iovAmnt = 0;
+	byte_t* bufStart = stream->strbuf;
+	size_t copyLimit = buf->writeEnd - stream->strbuf;
+
+	if(copyLimit > PLF_IOV_COPYSIZE - 1)
+		copyLimit = PLF_IOV_COPYSIZE - 1;
+
+	for(size_t i = 0; i < pieceAmnt; i++){
+		size_t size = pieces[i].size;
+
+		if(size == 0)
+			continue;
+
+		if(size <= copyLimit){
+			if(size > (size_t)(buf->writeEnd - buf->writePos) && plFWritevBuf(stream, iov, &iovAmnt, &bufStart))
+				return 0;
+
+			memcpy(buf->writePos, pieces[i].array, size);
+			buf->writePos += size;
+			continue;
+		}
+
+		if(buf->writePos > bufStart){
+			iov[iovAmnt].iov_base = bufStart;
+			iov[iovAmnt].iov_len = buf->writePos - bufStart;
+			iovAmnt++;
+			bufStart = buf->writePos;
+		}
+
+		iov[iovAmnt].iov_base = pieces[i].array;
+		iov[iovAmnt].iov_len = size;
+		iovAmnt++;
+
+		if(iovAmnt >= PLF_IOV_BATCH - 1 && plFWritevBuf(stream, iov, &iovAmnt, &bufStart))
+			return 0;
+	}
+
+	/* Copied pieces can stay in the buffer if nothing else has to be written */
+	if(iovAmnt != 0 && plFWritevBuf(stream, iov, &iovAmnt, &bufStart))
+		return 0;
+
+	if(stream->flushMode == PLF_FLUSH_LINE && plFWriteBuf(stream))
+		return 0;
+
+	return totalSize;
+}
+
+/* Returns a view of the next size bytes of the file stream without consuming them. The view *\
+|* points into the stream and stays valid until the next call on it. It can be shorter than  *|
+\* size at the end of file, or if size is bigger than the buffer of an actual file            */
+plarray_t plFPeek(plfile_t* stream, size_t size){
+	plarray_t returnArray = { NULL, 0, false, NULL };
+
+	if(stream == NULL)
+		return returnArray;
+
+	size_t availSize = plFFillPeek(stream, size);
+	if(availSize != 0){
+		returnArray.array = stream->buf.readPos;
+		returnArray.size = (availSize < size) ? availSize : size;
+	}
+
+	return returnArray;
+}
+
+/* Returns a view of every byte that can be read from the file stream without another refill */
+plarray_t plFView(plfile_t* stream){
+	plarray_t returnArray = { NULL, 0, false, NULL };
+
+	if(stream == NULL)
+		return returnArray;
+
+	size_t availSize = plFFillRead(stream);
+	if(availSize != 0){
+		returnArray.array = stream->buf.readPos;
+		returnArray.size = availSize;
+	}
+
+	return returnArray;
+}
+
+/* Consumes size bytes of a view returned by plFPeek or plFView. Returns 1 if there aren't that many */
+int plFAdvance(plfile_t* stream, size_t size){
+	if(stream == NULL || size > (size_t)(stream->buf.readEnd - stream->buf.readPos))
+		return 1;
+
+	stream->buf.readPos += size;
+	return 0;
+}
+
+/* Returns a view of the next line of the file stream without its newline, and consumes it. The *\
+|* last line doesn't need a newline, and the view has a NULL array at the end of file. The view  *|
+|* stays valid until the next call on the stream. Actual files grow their buffer if a line is    *|
+\* longer than it                                                                                 */
+plarray_t plFNextLine(plfile_t* stream){
+	plarray_t returnArray = { NULL, 0, false, NULL };
+
+	if(stream == NULL)
+		return returnArray;
+
+	plfilebuf_t* buf = &stream->buf;
+	size_t availSize = plFFillRead(stream);
+	size_t scannedSize = 0;
+	byte_t* endMark;
+
+	if(availSize == 0)
+		return returnArray;
+
+	/* Only the bytes read in since the last search get scanned */
+	while((endMark = memchr(buf->readPos + scannedSize, '\n', availSize - scannedSize)) == NULL && stream->fd != -1){
+		scannedSize = availSize;
+		if(availSize == stream->bufsize && plFGrowBuf(stream))
+			break;
+
+		availSize = plFFillPeek(stream, availSize + 1);
+		if(availSize == scannedSize && stream->pipe != NULL){
+			/* Lines that are still being written to a pipe stay in it. The rest of the line might *\
+			\* have been committed right before the write end closed, so it gets one more try     */
+			if(!__atomic_load_n(&stream->pipe->isWriterClosed, __ATOMIC_ACQUIRE)){
+				errno = EAGAIN;
+				return returnArray;
+			}
+
+			availSize = plFFillPeek(stream, availSize + 1);
+		}
+
+		if(availSize == scannedSize)
+			break;
+	}
+
+	returnArray.array = buf->readPos;
+	returnArray.size = (endMark != NULL) ? (size_t)(endMark - buf->readPos) : availSize;
+	buf->readPos += returnArray.size + (endMark != NULL);
+	return returnArray;
+}
+
+/* Slow path of plFPutC, for when the write window is full or closed */
+int plFPutCSlow(byte_t ch, plfile_t* stream){
+	if(stream == NULL)
+		return EOF;
+
+	if(plFFillWrite(stream, 1) == 0){
+		if(stream->buf.writePos == NULL || stream->flushMode != PLF_FLUSH_NONE || plFWriteAll(stream, &ch, 1))
+			return EOF;
+
+		return ch;
+	}
+
+	*stream->buf.writePos++ = ch;
+	if(ch == '\n' && stream->flushMode == PLF_FLUSH_LINE && plFFlush(stream) && !plFIsDeferred(stream))
+		return EOF;
+
+	return ch;
+}
+
+/* Slow path of plFGetC, for when the read window is empty or closed */
+int plFGetCSlow(plfile_t* stream){
+	if(stream == NULL || plFFillRead(stream) == 0)
+		return EOF;
+
+	return *stream->buf.readPos++;
+}
+
+/* Slow path of plFPuts, for when the string doesn't fit in the write window */
+int plFPutsSlow(string_t string, plfile_t* stream){
+	if(stream == NULL || string == NULL)
+		return EOF;
+
+	size_t size = strlen(string);
+	if(plFWriteBytes(stream, (byte_t*)string, size) != size)
+		return EOF;
+
+	return 0;
+}
+
+/* Slow path of plFGets, for when the line isn't completely inside the read window */
+string_t plFGetsSlow(string_t string, int num, plfile_t* stream){
+	if(stream == NULL || string == NULL || num < 2)
+		return NULL;
+
+	plfilebuf_t* buf = &stream->buf;
+	size_t lineSize = 0;
+
+	while(lineSize < (size_t)num - 1){
+		size_t availSize = plFFillRead(stream);
+		if(availSize == 0)
+			break;
+
+		if(availSize > (size_t)num - 1 - lineSize)
+			availSize = num - 1 - lineSize;
+
+		byte_t* endMark = memchr(buf->readPos, '\n', availSize);
+		if(endMark != NULL)
+			availSize = endMark - buf->readPos + 1;
+
+		memcpy(string + lineSize, buf->readPos, availSize);
+		buf->readPos += availSize;
+		lineSize += availSize;
+
+		if(endMark != NULL)
+			break;
+	}
+
+	if(lineSize == 0)
+		return NULL;
+
+	string[lineSize] = '\0';
+	return string;
+}
+
+/* Moves the seek position offset amount of bytes relative from whence */
+int plFSeek(plfile_t* stream, long int offset, int whence){
+	if(stream == NULL || stream->pipe != NULL || plFCloseWindow(stream))
+		return 1;
+
+	if(stream->fd != -1)
+		return plFSysSeek(stream, offset, whence) == -1;
+
+	size_t basePos;
+	switch(whence){
+		case SEEK_SET:
+			basePos = 0;
+			break;
+		case SEEK_CUR:
+			basePos = stream->seekbyte;
+			break;
+		case SEEK_END:
+			basePos = stream->datasize;
+			break;
+		default:
+			return 1;
+	}
+
+	if((offset < 0 && (size_t)-offset > basePos) || (offset > 0 && (size_t)offset > stream->datasize - basePos))
+		return 1;
+
+	stream->seekbyte = basePos + offset;
+	return 0;
+}
+
+/* Tells you the current seek position */
+size_t plFTell(plfile_t* stream){
+	if(stream == NULL)
+		return 0;
+
+	plfilebuf_t* buf = &stream->buf;
+	if(stream->fd == -1){
+		if(buf->readPos != NULL)
+			return buf->readPos - stream->strbuf;
+		if(buf->writePos != NULL)
+			return buf->writePos - stream->strbuf;
+
+		return stream->seekbyte;
+	}
+
+	off_t filePos = plFSysSeek(stream, 0, SEEK_CUR);
+	if(filePos == -1)
+		return 0;
+
+	if(buf->writePos != NULL)
+		return filePos + (buf->writePos - stream->strbuf);
+
+	return filePos - (buf->readEnd - buf->readPos);
+}
+
+/* Converts a memory buffer into a physical file */
+int plFPToFile(string_t filename, plfile_t* stream){
+	if(stream == NULL || filename == NULL || (stream->fd != -1 && !stream->isSpilled))
+		plPanic("plFPToFile: Stream and/or filename is NULL, or the stream is not a file-in-memory", false, true);
+
+	/* Files in memory that spilled are copied out of their temporary file */
+	if(stream->isSpilled){
+		size_t seekPos = plFTell(stream);
+		plfile_t* realFile = plFOpen(filename, "w", stream->mtptr);
+		if(realFile == NULL)
+			plPanic("plFPToFile", true, false);
+
+		plFSeek(stream, 0, SEEK_END);
+		size_t fileSize = plFTell(stream);
+		int retVar = plFCat(realFile, stream, SEEK_SET, SEEK_SET, false) != fileSize;
+		if(plFClose(realFile) || plFSeek(stream, seekPos, SEEK_SET))
+			retVar = 1;
+
+		return retVar;
+	}
+
+	plFCloseWindow(stream);
+	FILE* realFile = fopen(filename, "w");
+	if(realFile == NULL)
+		plPanic("plFPToFile", true, false);
+
+	int retVar = stream->datasize != 0 && fwrite(stream->strbuf, 1, stream->datasize, realFile) != stream->datasize;
+	if(fclose(realFile))
+		retVar = 1;
+
+	return retVar;
+}
+
+/* Copies the rest of src into dest within the kernel, using copy_file_range or sendfile if *\
+|* the former doesn't work on these files. Returns the amount of bytes copied, and leaves     *|
+\* whatever couldn't be copied to the caller                                                 */
+static size_t plFCatKernel(plfile_t* dest, plfile_t* src){
+	size_t copiedSize = 0;
+
+	if(plFCloseWindow(dest) || plFCloseWindow(src))
+		return 0;
+
+#ifdef __linux__
+	ssize_t chunkSize;
+
+	do{
+		chunkSize = copy_file_range(src->fd, NULL, dest->fd, NULL, PLF_CAT_CHUNK, 0);
+		if(chunkSize > 0)
+			copiedSize += chunkSize;
+	}while(chunkSize > 0 || (chunkSize < 0 && errno == EINTR));
+
+	if(chunkSize == 0)
+		return copiedSize;
+
+	do{
+		chunkSize = sendfile(dest->fd, src->fd, NULL, PLF_CAT_CHUNK);
+		if(chunkSize > 0)
+			copiedSize += chunkSize;
+	}while(chunkSize > 0 || (chunkSize < 0 && errno == EINTR));
+#endif
+
+	return copiedSize;
+}
+
+/* Reads the rest of a regular file straight into a file in memory, growing it only once. *\
+\* Returns the amount of bytes copied, and leaves whatever couldn't be copied to the caller */
+static size_t plFCatToMemory(plfile_t* dest, plfile_t* src){
+	plfilebuf_t* buf = &dest->buf;
+	struct stat fileInfo;
+	off_t filePos;
+
+	if(plFCloseWindow(src) || fstat(src->fd, &fileInfo) == -1 || !S_ISREG(fileInfo.st_mode) || (filePos = lseek(src->fd, 0, SEEK_CUR)) == -1 || filePos >= fileInfo.st_size)
+		return 0;
+
+	size_t leftSize = fileInfo.st_size - filePos;
+	size_t copiedSize = 0;
+
+	if(plFFillWrite(dest, leftSize) < leftSize)
+		return 0;
+
+	while(copiedSize < leftSize){
+		ssize_t readSize = read(src->fd, buf->writePos, leftSize - copiedSize);
+
+		if(readSize < 0 && errno == EINTR)
+			continue;
+		if(readSize <= 0)
+			break;
+
+		buf->writePos += readSize;
+		copiedSize += readSize;
+	}
+
+	return copiedSize;
+}
+
+/* Concatenates two files, copying src from srcWhence onwards to dest at destWhence. Actual files are *\
+|* copied within the kernel if possible, and everything else gets copied in bulk through the views   *|
+\* of src (See plFView). Returns the amount of bytes copied                                           */
+size_t plFCat(plfile_t* dest, plfile_t* src, int destWhence, int srcWhence, bool closeSrc){
+	if(dest == NULL || src == NULL)
+		plPanic("plFCat: Destination and/or source stream is NULL", false, true);
 
 	plFSeek(dest, 0, destWhence);
 	plFSeek(src, 0, srcWhence);
-	byte_t ch;
+	size_t copiedSize = 0;
+	plarray_t view;
+
+	if(src->filter != NULL || dest->filter != NULL || src->pipe != NULL || dest->pipe != NULL || src->fileptr != NULL || dest->fileptr != NULL)
+		copiedSize = 0;
+	else if(src->fd != -1 && dest->fd != -1)
+		copiedSize = plFCatKernel(dest, src);
+	else if(src->fd != -1 && !dest->isMapped)
+		copiedSize = plFCatToMemory(dest, src);
 
-	while((ch = plFGetC(src)) != '\0')
-		plFPutC(ch, dest);
+	while((view = plFView(src)).size != 0){
+		size_t writtenSize = plFWriteBytes(dest, view.array, view.size);
+
+		plFAdvance(src, writtenSize);
+		copiedSize += writtenSize;
+		if(writtenSize != view.size)
+			break;
+	}
 
 	if(closeSrc)
 		plFClose(src);
+
+	return copiedSize;
+}
+
+/* Appends a request to a queue */
+static void plFAioPush(plfaioqueue_t* queue, plfaioreq_t* req){
+	req->next = NULL;
+	if(queue->tail != NULL)
+		queue->tail->next = req;
+	else
+		queue->head = req;
+
+	queue->tail = req;
+}
+
+/* Takes the first request out of a queue, or returns NULL if it's empty */
+static plfaioreq_t* plFAioPop(plfaioqueue_t* queue){
+	plfaioreq_t* req = queue->head;
+
+	if(req != NULL){
+		queue->head = req->next;
+		if(queue->head == NULL)
+			queue->tail = NULL;
+	}
+
+	return req;
+}
+
+/* Runs a request with pread or pwrite, storing the amount of bytes or a negative errno value */
+static void plFAioRun(plfaioreq_t* req){
+	ssize_t result;
+
+	do{
+		if(req->isWrite)
+			result = pwrite(req->stream->fd, req->iov.iov_base, req->iov.iov_len, req->offset);
+		else
+			result = pread(req->stream->fd, req->iov.iov_base, req->iov.iov_len, req->offset);
+	}while(result < 0 && errno == EINTR);
+
+	req->result = (result < 0) ? -errno : result;
+}
+
+/* Worker thread of the thread pool backend */
+static void* plFAioWorker(void* aioPtr){
+	plfaio_t* aio = aioPtr;
+
+	pthread_mutex_lock(&aio->lock);
+	while(true){
+		while(aio->pending.head == NULL && !aio->isStopping)
+			pthread_cond_wait(&aio->workCond, &aio->lock);
+
+		plfaioreq_t* req = plFAioPop(&aio->pending);
+		if(req == NULL)
+			break;
+
+		pthread_mutex_unlock(&aio->lock);
+		plFAioRun(req);
+		pthread_mutex_lock(&aio->lock);
+
+		plFAioPush(&aio->completed, req);
+		pthread_cond_signal(&aio->doneCond);
+	}
+	pthread_mutex_unlock(&aio->lock);
+
+	return NULL;
+}
+
+#ifdef PLF_HAVE_IOURING
+/* Unmaps the rings of an io_uring instance and closes it */
+static void plFAioRingStop(plfaio_t* aio){
+	if(aio->sqes != NULL && aio->sqes != MAP_FAILED)
+		munmap(aio->sqes, aio->sqesSize);
+	if(aio->cqRing != NULL && aio->cqRing != MAP_FAILED && aio->cqRing != aio->sqRing)
+		munmap(aio->cqRing, aio->cqRingSize);
+	if(aio->sqRing != NULL && aio->sqRing != MAP_FAILED)
+		munmap(aio->sqRing, aio->sqRingSize);
+
+	close(aio->ringFd);
+}
+
+/* Sets up an io_uring instance with at least entries submission entries. Returns 1 on failure */
+static int plFAioRingSetup(plfaio_t* aio, unsigned int entries){
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+	aio->ringFd = syscall(__NR_io_uring_setup, entries, &params);
+	if(aio->ringFd < 0)
+		return 1;
+
+	aio->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	aio->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	aio->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	aio->cqRing = NULL;
+	aio->sqes = NULL;
+
+	/* Newer kernels map both rings at once */
+	if(params.features & IORING_FEAT_SINGLE_MMAP){
+		if(aio->cqRingSize > aio->sqRingSize)
+			aio->sqRingSize = aio->cqRingSize;
+		aio->cqRingSize = aio->sqRingSize;
+	}
+
+	aio->sqRing = mmap(NULL, aio->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ringFd, IORING_OFF_SQ_RING);
+	if(aio->sqRing == MAP_FAILED){
+		plFAioRingStop(aio);
+		return 1;
+	}
+
+	if(params.features & IORING_FEAT_SINGLE_MMAP)
+		aio->cqRing = aio->sqRing;
+	else
+		aio->cqRing = mmap(NULL, aio->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ringFd, IORING_OFF_CQ_RING);
+
+	aio->sqes = mmap(NULL, aio->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, aio->ringFd, IORING_OFF_SQES);
+	if(aio->cqRing == MAP_FAILED || aio->sqes == MAP_FAILED){
+		plFAioRingStop(aio);
+		return 1;
+	}
+
+	aio->sqEntries = params.sq_entries;
+	aio->cqEntries = params.cq_entries;
+	aio->unsubmittedAmnt = 0;
+	aio->sqHead = (unsigned int*)(aio->sqRing + params.sq_off.head);
+	aio->sqTail = (unsigned int*)(aio->sqRing + params.sq_off.tail);
+	aio->sqMask = (unsigned int*)(aio->sqRing + params.sq_off.ring_mask);
+	aio->sqArray = (unsigned int*)(aio->sqRing + params.sq_off.array);
+	aio->cqHead = (unsigned int*)(aio->cqRing + params.cq_off.head);
+	aio->cqTail = (unsigned int*)(aio->cqRing + params.cq_off.tail);
+	aio->cqMask = (unsigned int*)(aio->cqRing + params.cq_off.ring_mask);
+	aio->cqes = (struct io_uring_cqe*)(aio->cqRing + params.cq_off.cqes);
+
+	return 0;
+}
+
+/* Hands entries from the submission ring to the kernel, and waits for at least one completion if waitAmnt is 1 */
+static void plFAioRingEnter(plfaio_t* aio, unsigned int waitAmnt){
+	int submitAmnt;
+
+	do{
+		submitAmnt = syscall(__NR_io_uring_enter, aio->ringFd, aio->unsubmittedAmnt, waitAmnt, (waitAmnt != 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	}while(submitAmnt < 0 && errno == EINTR);
+
+	if(submitAmnt > 0)
+		aio->unsubmittedAmnt -= submitAmnt;
+}
+
+/* Moves queued requests into the submission ring, without overflowing the completion ring. Returns the amount of requests moved */
+static size_t plFAioRingSubmit(plfaio_t* aio){
+	unsigned int sqTail = *aio->sqTail;
+	unsigned int sqHead = __atomic_load_n(aio->sqHead, __ATOMIC_ACQUIRE);
+	size_t submitAmnt = 0;
+
+	while(aio->queued.head != NULL && sqTail - sqHead < aio->sqEntries && aio->inFlightAmnt < aio->cqEntries){
+		plfaioreq_t* req = plFAioPop(&aio->queued);
+		unsigned int index = sqTail & *aio->sqMask;
+		struct io_uring_sqe* sqe = &aio->sqes[index];
+
+		memset(sqe, 0, sizeof(struct io_uring_sqe));
+		sqe->opcode = (req->isWrite) ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->fd = req->stream->fd;
+		sqe->off = req->offset;
+		sqe->addr = (uintptr_t)&req->iov;
+		sqe->len = 1;
+		sqe->user_data = (uintptr_t)req;
+		aio->sqArray[index] = index;
+
+		sqTail++;
+		submitAmnt++;
+		aio->inFlightAmnt++;
+	}
+
+	__atomic_store_n(aio->sqTail, sqTail, __ATOMIC_RELEASE);
+	aio->unsubmittedAmnt += submitAmnt;
+	if(aio->unsubmittedAmnt != 0)
+		plFAioRingEnter(aio, 0);
+
+	return submitAmnt;
+}
+
+/* Moves every completion out of the completion ring, waiting for one if there are none and wait is set */
+static void plFAioRingReap(plfaio_t* aio, bool wait){
+	unsigned int cqHead = *aio->cqHead;
+	unsigned int cqTail = __atomic_load_n(aio->cqTail, __ATOMIC_ACQUIRE);
+
+	if(cqHead == cqTail && wait){
+		plFAioRingEnter(aio, 1);
+		cqTail = __atomic_load_n(aio->cqTail, __ATOMIC_ACQUIRE);
+	}
+
+	while(cqHead != cqTail){
+		struct io_uring_cqe* cqe = &aio->cqes[cqHead & *aio->cqMask];
+		plfaioreq_t* req = (plfaioreq_t*)(uintptr_t)cqe->user_data;
+
+		req->result = cqe->res;
+		plFAioPush(&aio->completed, req);
+		cqHead++;
+	}
+
+	__atomic_store_n(aio->cqHead, cqHead, __ATOMIC_RELEASE);
+}
+#endif
+
+/* Creates an asynchronous I/O context, which can have up to queueSize requests in flight at once *\
+|* with io_uring. PLF_AIO_AUTO uses io_uring if the kernel allows it and a thread pool otherwise. *|
+\* Returns NULL if the requested backend isn't available                                          */
+plfaio_t* plFAioInit(unsigned int queueSize, plfaiobackend_t backend, plmt_t* mt){
+	if(mt == NULL)
+		plPanic("plFAioInit: Memory tracker was set to NULL", false, true);
+
+	plfaio_t* aio = plMTAllocE(mt, sizeof(plfaio_t));
+
+	aio->mt = mt;
+	aio->queued.head = NULL;
+	aio->queued.tail = NULL;
+	aio->completed.head = NULL;
+	aio->completed.tail = NULL;
+	aio->pending.head = NULL;
+	aio->pending.tail = NULL;
+	aio->inFlightAmnt = 0;
+	aio->isStopping = false;
+
+	if(queueSize == 0)
+		queueSize = 64;
+
+	aio->backend = PLF_AIO_THREADS;
+#ifdef PLF_HAVE_IOURING
+	if(backend != PLF_AIO_THREADS && plFAioRingSetup(aio, queueSize) == 0)
+		aio->backend = PLF_AIO_URING;
+#endif
+
+	if(backend == PLF_AIO_URING && aio->backend != PLF_AIO_URING){
+		plMTFree(mt, aio);
+		return NULL;
+	}
+
+	if(pthread_mutex_init(&aio->lock, NULL) || pthread_cond_init(&aio->doneCond, NULL) || pthread_cond_init(&aio->workCond, NULL))
+		plPanic("plFAioInit: Failed to initialize locks", false, false);
+
+	if(aio->backend == PLF_AIO_THREADS){
+		for(int i = 0; i < PLF_AIO_WORKERS; i++){
+			if(pthread_create(&aio->workers[i], NULL, plFAioWorker, aio))
+				plPanic("plFAioInit: Failed to create worker threads", false, false);
+		}
+	}
+
+	return aio;
+}
+
+/* Queues a request of a file stream. Files in memory are handled right away */
+static int plFAioQueue(plfaio_t* aio, plfile_t* stream, size_t offset, byte_t* buffer, size_t size, bool isWrite, memptr_t userData){
+	plfaioreq_t* req = plMTAlloc(aio->mt, sizeof(plfaioreq_t));
+
+	if(req == NULL){
+		plMTFree(stream->mtptr, buffer);
+		return 1;
+	}
+
+	req->stream = stream;
+	req->userData = userData;
+	req->iov.iov_base = buffer;
+	req->iov.iov_len = size;
+	req->offset = offset;
+	req->isWrite = isWrite;
+
+	/* Buffered data has to reach the file before the request does */
+	plFCloseWindow(stream);
+	if(isWrite && stream->fd == -1 && stream->spillSize != 0 && (offset > stream->spillSize || size > stream->spillSize - offset))
+		plFSpill(stream);
+
+	if(stream->fd != -1){
+		plFAioPush(&aio->queued, req);
+		return 0;
+	}
+
+	if(isWrite && stream->isMapped){
+		req->result = -EBADF;
+	}else if(isWrite){
+		if(offset > SIZE_MAX - size || plFMemReserve(stream, offset + size)){
+			req->result = -ENOMEM;
+		}else{
+			/* Writing past the end leaves a zeroed gap, like sparse files */
+			if(offset > stream->datasize)
+				memset(stream->strbuf + stream->datasize, 0, offset - stream->datasize);
+
+			memcpy(stream->strbuf + offset, buffer, size);
+			if(offset + size > stream->datasize)
+				stream->datasize = offset + size;
+			req->result = size;
+		}
+	}else{
+		req->result = (offset < stream->datasize) ? stream->datasize - offset : 0;
+		if(req->result > (int64_t)size)
+			req->result = size;
+
+		if(req->result > 0)
+			memcpy(buffer, stream->strbuf + offset, req->result);
+	}
+
+	pthread_mutex_lock(&aio->lock);
+	plFAioPush(&aio->completed, req);
+	aio->inFlightAmnt++;
+	pthread_mutex_unlock(&aio->lock);
+	return 0;
+}
+
+/* Queues a read of size bytes at offset of a file stream, into a buffer allocated from its memory *\
+|* tracker. The read doesn't use or move the seek position, and goes out with the next call to  *|
+\* plFAioSubmit. Returns 1 on failure                                                             */
+int plFReadAsync(plfaio_t* aio, plfile_t* stream, size_t offset, size_t size, memptr_t userData){
+	if(aio == NULL || stream == NULL || size == 0 || stream->filter != NULL || stream->pipe != NULL)
+		return 1;
+
+	byte_t* buffer = plMTAlloc(stream->mtptr, size);
+	if(buffer == NULL)
+		return 1;
+
+	return plFAioQueue(aio, stream, offset, buffer, size, false, userData);
+}
+
+/* Queues a write of size bytes at offset of a file stream. data gets copied into a buffer allocated *\
+\* from the memory tracker of the stream, so it can be reused right away. Returns 1 on failure       */
+int plFWriteAsync(plfaio_t* aio, plfile_t* stream, size_t offset, memptr_t data, size_t size, memptr_t userData){
+	if(aio == NULL || stream == NULL || data == NULL || size == 0 || stream->filter != NULL || stream->pipe != NULL)
+		return 1;
+
+	byte_t* buffer = plMTAlloc(stream->mtptr, size);
+	if(buffer == NULL)
+		return 1;
+
+	memcpy(buffer, data, size);
+	return plFAioQueue(aio, stream, offset, buffer, size, true, userData);
+}
+
+/* Sends every queued request out at once. Returns the amount of requests sent, which can be less *\
+\* than the amount queued if io_uring is full, in which case plFAioReap sends out the rest later   */
+size_t plFAioSubmit(plfaio_t* aio){
+	if(aio == NULL)
+		return 0;
+
+#ifdef PLF_HAVE_IOURING
+	if(aio->backend == PLF_AIO_URING)
+		return plFAioRingSubmit(aio);
+#endif
+
+	size_t submitAmnt = 0;
+	plfaioreq_t* req;
+
+	pthread_mutex_lock(&aio->lock);
+	while((req = plFAioPop(&aio->queued)) != NULL){
+		plFAioPush(&aio->pending, req);
+		aio->inFlightAmnt++;
+		submitAmnt++;
+	}
+
+	if(submitAmnt != 0)
+		pthread_cond_broadcast(&aio->workCond);
+	pthread_mutex_unlock(&aio->lock);
+
+	return submitAmnt;
+}
+
+/* Collects up to maxResults finished requests. If wait is set and nothing has finished yet, it waits *\
+|* for at least one request. Buffers of reads are handed over to the caller, who has to free them    *|
+\* with the memory tracker of the stream. Returns the amount of results stored                        */
+size_t plFAioReap(plfaio_t* aio, plfaioresult_t* results, size_t maxResults, bool wait){
+	if(aio == NULL || results == NULL)
+		return 0;
+
+	if(aio->queued.head != NULL)
+		plFAioSubmit(aio);
+
+	size_t resultAmnt = 0;
+	pthread_mutex_lock(&aio->lock);
+
+#ifdef PLF_HAVE_IOURING
+	if(aio->backend == PLF_AIO_URING){
+		plFAioRingReap(aio, false);
+		while(wait && aio->completed.head == NULL && aio->inFlightAmnt != 0)
+			plFAioRingReap(aio, true);
+	}
+#endif
+
+	while(wait && aio->completed.head == NULL && aio->inFlightAmnt != 0)
+		pthread_cond_wait(&aio->doneCond, &aio->lock);
+
+	plfaioreq_t* req;
+	while(resultAmnt < maxResults && (req = plFAioPop(&aio->completed)) != NULL){
+		plfaioresult_t* result = &results[resultAmnt];
+
+		result->stream = req->stream;
+		result->userData = req->userData;
+		result->result = req->result;
+		result->buffer.array = NULL;
+		result->buffer.size = 0;
+		result->buffer.isMemAlloc = false;
+		result->buffer.mt = NULL;
+
+		if(!req->isWrite && req->result > 0){
+			result->buffer.array = req->iov.iov_base;
+			result->buffer.size = req->result;
+			result->buffer.isMemAlloc = true;
+			result->buffer.mt = req->stream->mtptr;
+		}else{
+			plMTFree(req->stream->mtptr, req->iov.iov_base);
+		}
+
+		plMTFree(aio->mt, req);
+		aio->inFlightAmnt--;
+		resultAmnt++;
+	}
+	pthread_mutex_unlock(&aio->lock);
+
+	return resultAmnt;
+}
+
+/* Waits for every request in flight, throwing away their results, and destroys the context. *\
+\* Queued requests that weren't submitted yet are sent out as well                            */
+int plFAioStop(plfaio_t* aio){
+	plfaioresult_t results[16];
+
+	if(aio == NULL)
+		return 1;
+
+	plFAioSubmit(aio);
+	while(aio->inFlightAmnt != 0 || aio->queued.head != NULL){
+		size_t resultAmnt = plFAioReap(aio, results, 16, true);
+
+		for(size_t i = 0; i < resultAmnt; i++){
+			if(results[i].buffer.array != NULL)
+				plMTFree(results[i].buffer.mt, results[i].buffer.array);
+		}
+	}
+
+	if(aio->backend == PLF_AIO_THREADS){
+		pthread_mutex_lock(&aio->lock);
+		aio->isStopping = true;
+		pthread_cond_broadcast(&aio->workCond);
+		pthread_mutex_unlock(&aio->lock);
+
+		for(int i = 0; i < PLF_AIO_WORKERS; i++)
+			pthread_join(aio->workers[i], NULL);
+	}
+#ifdef PLF_HAVE_IOURING
+	else{
+		plFAioRingStop(aio);
+	}
+#endif
+
+	pthread_cond_destroy(&aio->workCond);
+	pthread_cond_destroy(&aio->doneCond);
+	pthread_mutex_destroy(&aio->lock);
+	plMTFree(aio->mt, aio);
+	return 0;
 }
@@ -3,7 +3,14 @@
  (c) 2022 pocketlinux32, Under MPL v2.0
  pl32-memory.c: Safe memory management module
 \*****************************************************/
+#define _GNU_SOURCE
 #include <pl32-memory.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+	#include <execinfo.h>
+#endif
 
 /* Internal enum for plMTManage() */
 typedef enum plmtiaction {
@@ -14,19 +21,182 @@ typedef enum plmtiaction {
 	PLMT_REALLOC,
 } plmtiaction_t;
 
+/* Internal enum for the allocation strategy of a memory tracker */
+typedef enum plmtmode {
+	PLMT_MODE_DEFAULT,
+	PLMT_MODE_ARENA,
+	PLMT_MODE_SHARED,
+} plmtmode_t;
+
+/* Alignment that malloc and slab blocks are guaranteed to have. Aligned allocations only *\
+\* need padding beyond it, and they can't be aligned to more than PLMT_MAX_ALIGN bytes    */
+#define PLMT_MIN_ALIGN (2 * sizeof(size_t))
+#define PLMT_MAX_ALIGN ((size_t)1 << 30)
+
+/* Every arena allocation is aligned to this amount of bytes */
+#define PLMT_ARENA_ALIGN 16
+#define PLMT_ARENA_DEFAULT_CHUNK (64 * 1024)
+
+/* Small allocations are served from slabs of fixed-size blocks. Block sizes are rounded *\
+\* up to PLMT_SLAB_ALIGN, and sizes over PLMT_SLAB_MAXSIZE always go through malloc      */
+#define PLMT_MAX_SIZECLASSES 16
+#define PLMT_SLAB_ALIGN 16
+#define PLMT_SLAB_MAXSIZE 1024
+#define PLMT_SLAB_SIZE 8192
+
+static size_t plMTDefaultSizeClasses[] = { 16, 32, 48, 64, 96, 128, 192, 256 };
+
 /* Internal type for representing internal pointer references */
 typedef struct plpointer {
 	memptr_t pointer;
 	size_t size;
+	uint32_t sizeClass; /* Slab size class + 1, 0 if the block came from malloc */
+	uint32_t offset; /* Distance from the start of the block to pointer */
 } plptr_t;
 
-/* Structure of the memory allocation tracker. This memory allocation tracker is thread-specific */
+/* Internal type for a slab size class. Free blocks are linked through their first bytes, *\
+\* and so are the slabs themselves, so they can be freed when the tracker is stopped      */
+typedef struct plslabclass {
+	size_t blockSize;
+	memptr_t freeList;
+	memptr_t slabList;
+} plslabclass_t;
+
+/* Internal type for a block of memory that arena trackers bump-allocate from. *\
+\* Each allocation within it is preceded by a header containing its size       */
+typedef struct plarenachunk {
+	struct plarenachunk* prev;
+	size_t size;
+	size_t offset;
+	size_t padding;
+} plarenachunk_t;
+
+/* Retained blocks are bucketed the same way as the allocation histogram */
+#define PLMT_RETAIN_BUCKETS PLMT_HISTOGRAM_SIZE
+
+/* Internal type for a block kept by plMTReset for reuse. It lives inside the block itself */
+typedef struct plretainedblock {
+	struct plretainedblock* next;
+	size_t size;
+} plretainedblock_t;
+
+/* Internal type for the state that only shared trackers have. Every thread that *\
+\* allocates from a shared tracker gets its own heap, which is a plain tracker    */
+typedef struct plmtshared {
+	pthread_key_t heapKey;
+	pthread_mutex_t heapLock; /* Only taken when a thread gets or gives up its heap */
+	plmt_t* heapList;
+} plmtshared_t;
+
+/* Header placed in front of every block handed out by a shared tracker. Once the *\
+\* block is freed by a thread other than its owner, size is reused as a list link */
+typedef struct plsharedheader {
+	uintptr_t owner; /* Heap owning the block, tagged with PLMT_SHARED_LIVE until the block gets freed */
+	union {
+		size_t size;
+		memptr_t next;
+	} data;
+} plsharedheader_t;
+
+/* Blocks of the mmap backends smaller than PLMT_MMAP_THRESHOLD come from malloc instead. *\
+|* Mappings of at least PLMT_HUGEPAGE_SIZE bytes can get transparent huge pages, and      *|
+\* MAP_HUGETLB mappings get rounded up to it                                               */
+#define PLMT_MMAP_THRESHOLD (256 * 1024)
+#define PLMT_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/* Internal enum for the options of the bundled mmap backends */
+typedef enum plmtmmapflag {
+	PLMT_MMAP_THP = 1,
+	PLMT_MMAP_HUGETLB = 2,
+} plmtmmapflag_t;
+
+/* Header placed in front of every block handed out by the mmap backends. pageSize is *\
+\* the granularity the mapping was rounded up to, or 0 if the block came from malloc   */
+typedef struct plmmapheader {
+	size_t size;
+	size_t pageSize;
+} plmmapheader_t;
+
+/* Sampled allocations keep up to PLMT_SAMPLE_DEPTH return addresses. Frees only look for *\
+|* a sample when the counting filter says the pointer might have one, and the filter has  *|
+\* PLMT_SAMPLE_FILTER counters                                                              */
+#define PLMT_SAMPLE_DEPTH 16
+#define PLMT_SAMPLE_FILTER 4096
+
+/* Internal type for a sampled allocation. frames holds the call stack that made it, innermost first */
+typedef struct plmtsample {
+	memptr_t pointer;
+	size_t size;
+	string_t tag;
+	int frameAmnt;
+	memptr_t frames[PLMT_SAMPLE_DEPTH];
+} plmtsample_t;
+
+/* Internal type for the state of the allocation profiler, only set in trackers that have it enabled */
+typedef struct plmtsampler {
+	size_t sampleRate;
+	uint64_t randomState; /* Updated with relaxed atomics, lost updates only make it less random */
+	string_t tag;
+	pthread_mutex_t lock; /* Taken when a sample gets added or removed */
+	plmtsample_t* samples;
+	size_t sampleAmnt;
+	size_t allocSampleAmnt;
+	uint16_t filter[PLMT_SAMPLE_FILTER];
+} plmtsampler_t;
+
+/* Statistics counters only have one writer each, so they're updated with relaxed atomic *\
+|* loads and stores instead of read-modify-write operations. This keeps snapshots taken  *|
+\* from other threads race-free without the cost of a locked instruction               */
+#ifndef PL32LIBNG_DISABLE_MTSTATS
+	#define PLMT_STAT_ADD(mt, field, amount) __atomic_store_n(&(mt)->stats.field, __atomic_load_n(&(mt)->stats.field, __ATOMIC_RELAXED) + (amount), __ATOMIC_RELAXED)
+	#define PLMT_STAT_ALLOC(mt, size) do { PLMT_STAT_ADD(mt, allocAmnt, 1); PLMT_STAT_ADD(mt, histogram[plMTHistogramBucket(size)], 1); } while(0)
+#else
+	#define PLMT_STAT_ADD(mt, field, amount)
+	#define PLMT_STAT_ALLOC(mt, size)
+#endif
+
+#define PLMT_SHARED_HEADER ((uint32_t)((sizeof(plsharedheader_t) + 15) & ~(size_t)15))
+/* Heaps are aligned, so the lowest bit of the owner of a block marks it as not freed yet */
+#define PLMT_SHARED_LIVE ((uintptr_t)1)
+
+/* Structure of the memory allocation tracker. Unless it was created by plMTInitShared, *\
+\* this memory allocation tracker is thread-specific                                   */
 struct plmt {
 	plptr_t* ptrList;
 	size_t listAmnt;
 	size_t allocListAmnt;
-	size_t usedMemory;
+	size_t* ptrIndex; /* Hash index of ptrList entries (index + 1, 0 means empty slot) */
+	size_t indexSize; /* Amount of slots in ptrIndex. Always a power of two */
+	size_t usedMemory; /* Memory used by this tracker and every tracker below it */
 	size_t maxMemory;
+	size_t ownMemory; /* Memory used by allocations made through this tracker itself */
+	size_t externalMemory; /* Memory charged with plMTChargeExternal, updated atomically */
+	size_t softMemory; /* Usage past which softCallback gets called, SIZE_MAX if there's no soft limit */
+	plmtpressurefunc_t softCallback;
+	plmtpressurefunc_t hardCallback;
+	memptr_t pressureData;
+	size_t pressureAmnt; /* Amount of times either callback was called */
+	plmtmode_t mode;
+	plarenachunk_t* arena; /* Current chunk of an arena tracker, linked to previous chunks */
+	size_t arenaChunkSize; /* Usable size of a regular arena chunk */
+	memptr_t arenaLast; /* Last allocation made by an arena tracker */
+	plslabclass_t slabClasses[PLMT_MAX_SIZECLASSES];
+	size_t slabClassAmnt;
+	uint8_t slabLookup[PLMT_SLAB_MAXSIZE / PLMT_SLAB_ALIGN + 1]; /* Size class + 1 for every PLMT_SLAB_ALIGN bytes of size */
+	plmt_t* parent; /* Tracker that also gets charged for every allocation, updated atomically */
+	plmt_t* childList;
+	plmt_t* nextChild;
+	pthread_mutex_t childLock; /* Only taken when a child tracker gets created or stopped */
+	plmtshared_t* shared; /* Only set in shared trackers */
+	plmt_t* nextHeap; /* Next heap of the same shared tracker */
+	memptr_t returnQueue; /* Lock-free list of blocks freed by threads other than the owner of this heap */
+	bool isOrphaned; /* Set when the thread owning this heap has exited */
+	plmtstats_t stats;
+	plmtsampler_t* sampler;
+	const plmtbackend_t* backend; /* Where blocks over the slab sizes and arena chunks come from */
+	plretainedblock_t* retainCache[PLMT_RETAIN_BUCKETS]; /* Blocks kept by plMTReset, by the position of the highest bit of their size */
+	size_t retainedMemory; /* Memory held in retainCache, updated atomically so shared trackers can add it up */
+	size_t retainLimit; /* Maximum amount of memory plMTReset keeps around, 0 if it releases everything */
 };
 
 /* Prints an error and aborts the program. Within pl32-memory, it's used whenever malloc fails */
@@ -39,139 +209,1573 @@ void plPanic(string_t msg, bool usePerror, bool developerBug){
 		fputs("\n", stderr);
 	}
 
-	if(developerBug)
-		fputs("* If you're seeing this message, this is a bug. Please report this error to the project maintainers\n", stderr);
+	if(developerBug)
+		fputs("* If you're seeing this message, this is a bug. Please report this error to the project maintainers\n", stderr);
+
+	abort();
+}
+
+/* Backend that uses the C library allocator */
+static memptr_t plMTMallocAlloc(memptr_t data, size_t size, bool zeroed){
+	(void)data;
+	return (zeroed) ? calloc(1, size) : malloc(size);
+}
+
+static memptr_t plMTMallocRealloc(memptr_t data, memptr_t block, size_t size){
+	(void)data;
+	return realloc(block, size);
+}
+
+static void plMTMallocFree(memptr_t data, memptr_t block){
+	(void)data;
+	free(block);
+}
+
+const plmtbackend_t plMTMallocBackend = { plMTMallocAlloc, plMTMallocRealloc, plMTMallocFree, NULL };
+
+/* Maps size bytes of anonymous memory, storing the granularity the mapping got rounded up to in pageSize. *\
+\* MAP_HUGETLB mappings fall back to regular pages if there are no huge pages available                  */
+static byte_t* plMTMmapMap(size_t size, int flags, size_t* pageSize){
+	byte_t* mapping = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+	if(flags & PLMT_MMAP_HUGETLB){
+		*pageSize = PLMT_HUGEPAGE_SIZE;
+		if(size + PLMT_HUGEPAGE_SIZE - 1 > size)
+			mapping = mmap(NULL, (size + PLMT_HUGEPAGE_SIZE - 1) & ~(size_t)(PLMT_HUGEPAGE_SIZE - 1), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	}
+#endif
+
+	if(mapping == MAP_FAILED){
+		*pageSize = sysconf(_SC_PAGESIZE);
+		mapping = mmap(NULL, (size + *pageSize - 1) & ~(*pageSize - 1), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	}
+
+	if(mapping == MAP_FAILED)
+		return NULL;
+
+#ifdef MADV_HUGEPAGE
+	if((flags & PLMT_MMAP_THP) && *pageSize != PLMT_HUGEPAGE_SIZE && size >= PLMT_HUGEPAGE_SIZE)
+		madvise(mapping, (size + *pageSize - 1) & ~(*pageSize - 1), MADV_HUGEPAGE);
+#endif
+
+	return mapping;
+}
+
+/* Backend that maps big blocks with mmap and resizes them with mremap, so growing them doesn't copy */
+static memptr_t plMTMmapAlloc(memptr_t data, size_t size, bool zeroed){
+	size_t blockSize = sizeof(plmmapheader_t) + size;
+	size_t pageSize = 0;
+	plmmapheader_t* header;
+
+	if(blockSize < size)
+		return NULL;
+
+	if(blockSize < PLMT_MMAP_THRESHOLD){
+		header = (zeroed) ? calloc(1, blockSize) : malloc(blockSize);
+	}else{
+		/* Fresh mappings are always zeroed */
+		header = (plmmapheader_t*)plMTMmapMap(blockSize, *((int*)data), &pageSize);
+		blockSize = (blockSize + pageSize - 1) & ~(pageSize - 1);
+	}
+
+	if(header == NULL)
+		return NULL;
+
+	header->size = blockSize;
+	header->pageSize = pageSize;
+	return header + 1;
+}
+
+static void plMTMmapFree(memptr_t data, memptr_t block){
+	plmmapheader_t* header = (plmmapheader_t*)block - 1;
+
+	(void)data;
+	if(header->pageSize == 0)
+		free(header);
+	else
+		munmap(header, header->size);
+}
+
+static memptr_t plMTMmapRealloc(memptr_t data, memptr_t block, size_t size){
+	plmmapheader_t* header = (plmmapheader_t*)block - 1;
+	size_t blockSize = sizeof(plmmapheader_t) + size;
+
+	if(blockSize < size)
+		return NULL;
+
+	if(header->pageSize == 0 && blockSize < PLMT_MMAP_THRESHOLD){
+		if((header = realloc(header, blockSize)) == NULL)
+			return NULL;
+
+		header->size = blockSize;
+		return header + 1;
+	}
+
+#ifdef __linux__
+	if(header->pageSize != 0 && blockSize + header->pageSize - 1 > blockSize){
+		size_t mapSize = (blockSize + header->pageSize - 1) & ~(header->pageSize - 1);
+		plmmapheader_t* newHeader = mremap(header, header->size, mapSize, MREMAP_MAYMOVE);
+
+		if(newHeader != MAP_FAILED){
+#ifdef MADV_HUGEPAGE
+			if((*((int*)data) & PLMT_MMAP_THP) && newHeader->pageSize != PLMT_HUGEPAGE_SIZE && mapSize >= PLMT_HUGEPAGE_SIZE)
+				madvise(newHeader, mapSize, MADV_HUGEPAGE);
+#endif
+
+			newHeader->size = mapSize;
+			return newHeader + 1;
+		}
+	}
+#endif
+
+	/* Moving between malloc and mmap, or mremap isn't available */
+	byte_t* newBlock = plMTMmapAlloc(data, size, false);
+	if(newBlock == NULL)
+		return NULL;
+
+	memcpy(newBlock, block, (header->size - sizeof(plmmapheader_t) < size) ? header->size - sizeof(plmmapheader_t) : size);
+	plMTMmapFree(data, block);
+	return newBlock;
+}
+
+static int plMTMmapFlags[3] = { 0, PLMT_MMAP_THP, PLMT_MMAP_THP | PLMT_MMAP_HUGETLB };
+const plmtbackend_t plMTMmapBackend = { plMTMmapAlloc, plMTMmapRealloc, plMTMmapFree, &plMTMmapFlags[0] };
+const plmtbackend_t plMTTHPBackend = { plMTMmapAlloc, plMTMmapRealloc, plMTMmapFree, &plMTMmapFlags[1] };
+const plmtbackend_t plMTHugeTLBBackend = { plMTMmapAlloc, plMTMmapRealloc, plMTMmapFree, &plMTMmapFlags[2] };
+
+/* Returns the histogram bucket of an allocation size, which is the position of its highest set bit */
+static inline size_t plMTHistogramBucket(size_t size){
+	size_t bucket = 0;
+
+	while(size > 1 && bucket < PLMT_HISTOGRAM_SIZE - 1){
+		size >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/* Hashes a pointer address into a slot of the pointer index */
+static size_t plMTIndexHash(plmt_t* mt, memptr_t ptr){
+	uint64_t hash = (uint64_t)(uintptr_t)ptr;
+
+	hash = (hash >> 4) * UINT64_C(0x9E3779B97F4A7C15);
+	hash ^= hash >> 32;
+	return (size_t)hash & (mt->indexSize - 1);
+}
+
+/* Returns the slot in the pointer index that holds ptr, or the empty slot where it would go */
+static size_t plMTIndexSlot(plmt_t* mt, memptr_t ptr){
+	size_t slot = plMTIndexHash(mt, ptr);
+
+	while(mt->ptrIndex[slot] != 0 && mt->ptrList[mt->ptrIndex[slot] - 1].pointer != ptr)
+		slot = (slot + 1) & (mt->indexSize - 1);
+
+	return slot;
+}
+
+/* Removes a slot from the pointer index, shifting back any entries that probed past it */
+static void plMTIndexRemove(plmt_t* mt, size_t slot){
+	size_t mask = mt->indexSize - 1;
+	size_t next = (slot + 1) & mask;
+
+	while(mt->ptrIndex[next] != 0){
+		size_t home = plMTIndexHash(mt, mt->ptrList[mt->ptrIndex[next] - 1].pointer);
+
+		/* Only move the entry if its home slot is not between the hole and itself */
+		if(((next - home) & mask) >= ((next - slot) & mask)){
+			mt->ptrIndex[slot] = mt->ptrIndex[next];
+			slot = next;
+		}
+
+		next = (next + 1) & mask;
+	}
+
+	mt->ptrIndex[slot] = 0;
+}
+
+/* Resizes the pointer index and rehashes every entry in ptrList into it */
+static void plMTIndexRebuild(plmt_t* mt, size_t newSize){
+	size_t* tempIndex = calloc(newSize, sizeof(size_t));
+	if(tempIndex == NULL)
+		plPanic("plMTManage: Failed to resize pointer index", false, false);
+
+	free(mt->ptrIndex);
+	mt->ptrIndex = tempIndex;
+	mt->indexSize = newSize;
+
+	for(size_t i = 0; i < mt->listAmnt; i++)
+		mt->ptrIndex[plMTIndexSlot(mt, mt->ptrList[i].pointer)] = i + 1;
+}
+
+/* Frees every slab of every size class */
+static void plMTSlabRelease(plmt_t* mt){
+	for(size_t i = 0; i < mt->slabClassAmnt; i++){
+		memptr_t slab = mt->slabClasses[i].slabList;
+
+		while(slab != NULL){
+			memptr_t nextSlab = *((memptr_t*)slab);
+			free(slab);
+			slab = nextSlab;
+		}
+
+		mt->slabClasses[i].slabList = NULL;
+		mt->slabClasses[i].freeList = NULL;
+	}
+}
+
+/* Sets up the slab size classes and the size to size class lookup table */
+static void plMTSlabSetup(plmt_t* mt, size_t* sizeClasses, size_t amount){
+	size_t classAmnt = 0;
+
+	for(size_t i = 0; i < amount; i++){
+		size_t blockSize = (sizeClasses[i] + PLMT_SLAB_ALIGN - 1) & ~(size_t)(PLMT_SLAB_ALIGN - 1);
+		size_t j = classAmnt;
+
+		if(blockSize == 0 || blockSize > PLMT_SLAB_MAXSIZE)
+			continue;
+
+		/* Insertion sort, skipping duplicates */
+		while(j > 0 && mt->slabClasses[j - 1].blockSize > blockSize)
+			j--;
+
+		if((j > 0 && mt->slabClasses[j - 1].blockSize == blockSize) || classAmnt == PLMT_MAX_SIZECLASSES)
+			continue;
+
+		memmove(mt->slabClasses + j + 1, mt->slabClasses + j, (classAmnt - j) * sizeof(plslabclass_t));
+		mt->slabClasses[j].blockSize = blockSize;
+		mt->slabClasses[j].freeList = NULL;
+		mt->slabClasses[j].slabList = NULL;
+		classAmnt++;
+	}
+
+	mt->slabClassAmnt = classAmnt;
+
+	size_t currentClass = 0;
+	for(size_t i = 0; i <= PLMT_SLAB_MAXSIZE / PLMT_SLAB_ALIGN; i++){
+		while(currentClass < classAmnt && mt->slabClasses[currentClass].blockSize < i * PLMT_SLAB_ALIGN)
+			currentClass++;
+
+		mt->slabLookup[i] = (currentClass < classAmnt) ? currentClass + 1 : 0;
+	}
+}
+
+/* Returns the slab size class + 1 that a block of size bytes belongs to, or 0 if it should go to malloc */
+static uint32_t plMTSlabClass(plmt_t* mt, size_t size){
+	if(size > PLMT_SLAB_MAXSIZE)
+		return 0;
+
+	return mt->slabLookup[(size + PLMT_SLAB_ALIGN - 1) / PLMT_SLAB_ALIGN];
+}
+
+/* Pops a block from a size class free list, carving a new slab if the list is empty */
+static memptr_t plMTSlabAlloc(plmt_t* mt, uint32_t sizeClass){
+	plslabclass_t* slabClass = &mt->slabClasses[sizeClass - 1];
+
+	if(slabClass->freeList == NULL){
+		size_t blockAmnt = PLMT_SLAB_SIZE / slabClass->blockSize;
+		if(blockAmnt < 4)
+			blockAmnt = 4;
+
+		byte_t* slab = malloc(PLMT_SLAB_ALIGN + blockAmnt * slabClass->blockSize);
+		if(slab == NULL)
+			return NULL;
+
+		*((memptr_t*)slab) = slabClass->slabList;
+		slabClass->slabList = slab;
+
+		for(size_t i = blockAmnt; i > 0; i--){
+			memptr_t block = slab + PLMT_SLAB_ALIGN + (i - 1) * slabClass->blockSize;
+			*((memptr_t*)block) = slabClass->freeList;
+			slabClass->freeList = block;
+		}
+	}
+
+	memptr_t block = slabClass->freeList;
+	slabClass->freeList = *((memptr_t*)block);
+	return block;
+}
+
+/* Pushes a block back into its size class free list */
+static void plMTSlabFree(plmt_t* mt, memptr_t block, uint32_t sizeClass){
+	plslabclass_t* slabClass = &mt->slabClasses[sizeClass - 1];
+
+	*((memptr_t*)block) = slabClass->freeList;
+	slabClass->freeList = block;
+}
+
+/* Keeps a block that came from the backend for reuse, as long as the retain limit allows it. *\
+\* Otherwise, the block gets released to the backend                                          */
+static void plMTRetainBlock(plmt_t* mt, memptr_t block, size_t size){
+	size_t retainedMemory = mt->retainedMemory;
+
+	if(size < sizeof(plretainedblock_t) || size > mt->retainLimit || retainedMemory > mt->retainLimit - size){
+		mt->backend->free(mt->backend->data, block);
+		return;
+	}
+
+	plretainedblock_t* retainedBlock = block;
+	size_t bucket = plMTHistogramBucket(size);
+
+	retainedBlock->size = size;
+	retainedBlock->next = mt->retainCache[bucket];
+	mt->retainCache[bucket] = retainedBlock;
+	__atomic_store_n(&mt->retainedMemory, retainedMemory + size, __ATOMIC_RELAXED);
+}
+
+/* Takes a retained block that can hold at least size bytes. Only the bucket of size and the *\
+\* one above it are looked at, so small requests don't eat up much bigger blocks            */
+static memptr_t plMTRetainTake(plmt_t* mt, size_t size){
+	size_t bucket = plMTHistogramBucket(size);
+
+	for(size_t i = bucket; i < bucket + 2 && i < PLMT_RETAIN_BUCKETS; i++){
+		plretainedblock_t* retainedBlock = mt->retainCache[i];
+
+		if(retainedBlock != NULL && retainedBlock->size >= size){
+			mt->retainCache[i] = retainedBlock->next;
+			__atomic_store_n(&mt->retainedMemory, mt->retainedMemory - retainedBlock->size, __ATOMIC_RELAXED);
+			return retainedBlock;
+		}
+	}
+
+	return NULL;
+}
+
+/* Releases every retained block to the backend */
+static void plMTRetainRelease(plmt_t* mt){
+	for(size_t i = 0; i < PLMT_RETAIN_BUCKETS; i++){
+		while(mt->retainCache[i] != NULL){
+			plretainedblock_t* retainedBlock = mt->retainCache[i];
+			mt->retainCache[i] = retainedBlock->next;
+			mt->backend->free(mt->backend->data, retainedBlock);
+		}
+	}
+
+	__atomic_store_n(&mt->retainedMemory, 0, __ATOMIC_RELAXED);
+}
+
+/* Allocates a block either from a slab, from the retained blocks or from the backend, storing where it came from in sizeClass */
+static memptr_t plMTBlockAlloc(plmt_t* mt, size_t size, bool zeroed, uint32_t* sizeClass){
+	memptr_t block;
+
+	*sizeClass = plMTSlabClass(mt, size);
+	if(*sizeClass == 0){
+		if(mt->retainedMemory != 0 && (block = plMTRetainTake(mt, size)) != NULL){
+			if(zeroed)
+				memset(block, 0, size);
+
+			return block;
+		}
+
+		return mt->backend->alloc(mt->backend->data, size, zeroed);
+	}
+
+	block = plMTSlabAlloc(mt, *sizeClass);
+	if(block != NULL && zeroed)
+		memset(block, 0, size);
+
+	return block;
+}
+
+/* Releases a block to wherever it came from */
+static void plMTBlockFree(plmt_t* mt, memptr_t block, uint32_t sizeClass){
+	if(sizeClass == 0)
+		mt->backend->free(mt->backend->data, block);
+	else
+		plMTSlabFree(mt, block, sizeClass);
+}
+
+/* Charges size bytes to a tracker and every tracker above it. Returns NULL on success, or the  *\
+|* tracker whose limit would be exceeded. Counters are updated with atomic compare-and-swap, as *|
+|* a tracker can be charged by its own allocations and by child trackers living in other      *|
+\* threads at the same time                                                                     */
+static plmt_t* plMTChargeChain(plmt_t* mt, size_t size){
+	for(plmt_t* chargeMT = mt; chargeMT != NULL; chargeMT = chargeMT->parent){
+		size_t usedMemory = __atomic_load_n(&chargeMT->usedMemory, __ATOMIC_RELAXED);
+
+		do{
+			if(usedMemory + size < usedMemory || usedMemory + size > __atomic_load_n(&chargeMT->maxMemory, __ATOMIC_RELAXED)){
+				for(plmt_t* chargedMT = mt; chargedMT != chargeMT; chargedMT = chargedMT->parent)
+					__atomic_sub_fetch(&chargedMT->usedMemory, size, __ATOMIC_RELAXED);
+
+				return chargeMT;
+			}
+		}while(!__atomic_compare_exchange_n(&chargeMT->usedMemory, &usedMemory, usedMemory + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+#ifndef PL32LIBNG_DISABLE_MTSTATS
+		size_t peakMemory = __atomic_load_n(&chargeMT->stats.peakMemory, __ATOMIC_RELAXED);
+		while(usedMemory + size > peakMemory && !__atomic_compare_exchange_n(&chargeMT->stats.peakMemory, &peakMemory, usedMemory + size, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#endif
+
+		/* Only the allocation that crosses the soft limit fires the callback */
+		size_t softMemory = __atomic_load_n(&chargeMT->softMemory, __ATOMIC_RELAXED);
+		if(chargeMT->softCallback != NULL && usedMemory <= softMemory && usedMemory + size > softMemory){
+			__atomic_add_fetch(&chargeMT->pressureAmnt, 1, __ATOMIC_RELAXED);
+			chargeMT->softCallback(chargeMT, size, chargeMT->pressureData);
+		}
+	}
+
+	return NULL;
+}
+
+/* Charges size bytes to a tracker and every tracker above it, failing if any limit would be *\
+|* exceeded. If the tracker that ran out of memory has a hard limit callback, it gets a      *|
+\* chance to free some memory before the charge is tried one more time                      */
+static bool plMTChargeLimits(plmt_t* mt, size_t size){
+	plmt_t* limitMT = plMTChargeChain(mt, size);
+
+	if(limitMT != NULL && limitMT->hardCallback != NULL){
+		__atomic_add_fetch(&limitMT->pressureAmnt, 1, __ATOMIC_RELAXED);
+		limitMT->hardCallback(limitMT, size, limitMT->pressureData);
+		limitMT = plMTChargeChain(mt, size);
+	}
+
+	if(limitMT != NULL){
+		PLMT_STAT_ADD(mt, failAmnt, 1);
+		return false;
+	}
+
+	return true;
+}
+
+/* Charges size bytes of tracked allocations to a tracker (See plMTChargeLimits) */
+static bool plMTCharge(plmt_t* mt, size_t size){
+	if(!plMTChargeLimits(mt, size))
+		return false;
+
+	mt->ownMemory += size;
+	return true;
+}
+
+/* Gives back size bytes to a tracker and every tracker above it */
+static void plMTUnchargeChain(plmt_t* mt, size_t size){
+	for(plmt_t* chargeMT = mt; chargeMT != NULL; chargeMT = chargeMT->parent)
+		__atomic_sub_fetch(&chargeMT->usedMemory, size, __ATOMIC_RELAXED);
+}
+
+/* Gives back size bytes of tracked allocations to a tracker and every tracker above it */
+static void plMTUncharge(plmt_t* mt, size_t size){
+	plMTUnchargeChain(mt, size);
+	mt->ownMemory -= size;
+}
+
+/* Hashes a pointer address into a counter of the sample filter */
+static size_t plMTSampleHash(memptr_t ptr){
+	uint64_t hash = (uint64_t)(uintptr_t)ptr;
+
+	hash = (hash >> 4) * UINT64_C(0x9E3779B97F4A7C15);
+	hash ^= hash >> 32;
+	return (size_t)hash & (PLMT_SAMPLE_FILTER - 1);
+}
+
+/* Decides whether an allocation gets sampled. Allocations of sampleRate bytes or more always do, *\
+|* smaller ones do with a chance of size / sampleRate, so that every sample stands for           *|
+\* max(size, sampleRate) bytes no matter what else the tracker allocates                         */
+static bool plMTSampleChance(plmtsampler_t* sampler, size_t size){
+	if(size >= sampler->sampleRate)
+		return true;
+
+	uint64_t randomState = __atomic_load_n(&sampler->randomState, __ATOMIC_RELAXED);
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	__atomic_store_n(&sampler->randomState, randomState, __ATOMIC_RELAXED);
+
+	return randomState % sampler->sampleRate < size;
+}
+
+/* Records the call stack of an allocation if it gets sampled. callerAddr is the return *\
+\* address of the public function, used to cut the allocator frames out of the stack     */
+static void plMTSampleAlloc(plmt_t* mt, memptr_t pointer, size_t size, memptr_t callerAddr){
+	plmtsampler_t* sampler = mt->sampler;
+
+	if(!plMTSampleChance(sampler, size))
+		return;
+
+	plmtsample_t sample = { pointer, size, __atomic_load_n(&sampler->tag, __ATOMIC_RELAXED), 0, { NULL } };
+#ifdef __GLIBC__
+	memptr_t frames[PLMT_SAMPLE_DEPTH + 4];
+	int frameAmnt = backtrace(frames, PLMT_SAMPLE_DEPTH + 4);
+	int firstFrame = 0;
+
+	while(firstFrame < frameAmnt && frames[firstFrame] != callerAddr)
+		firstFrame++;
+
+	if(firstFrame == frameAmnt)
+		firstFrame = 0;
+
+	sample.frameAmnt = (frameAmnt - firstFrame > PLMT_SAMPLE_DEPTH) ? PLMT_SAMPLE_DEPTH : frameAmnt - firstFrame;
+	memcpy(sample.frames, frames + firstFrame, sample.frameAmnt * sizeof(memptr_t));
+#else
+	sample.frames[0] = callerAddr;
+	sample.frameAmnt = 1;
+#endif
+
+	pthread_mutex_lock(&sampler->lock);
+	if(sampler->sampleAmnt == sampler->allocSampleAmnt){
+		plmtsample_t* tempSamples = realloc(sampler->samples, sampler->allocSampleAmnt * 2 * sizeof(plmtsample_t));
+		if(tempSamples == NULL)
+			plPanic("plMTSampleAlloc: Failed to allocate memory", false, false);
+
+		sampler->samples = tempSamples;
+		sampler->allocSampleAmnt *= 2;
+	}
+
+	size_t filterSlot = plMTSampleHash(pointer);
+	sampler->samples[sampler->sampleAmnt] = sample;
+	sampler->sampleAmnt++;
+	__atomic_store_n(&sampler->filter[filterSlot], sampler->filter[filterSlot] + 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&sampler->lock);
+}
+
+/* Moves the sample of a pointer to newPointer after it got reallocated, or drops it if newPointer is NULL */
+static void plMTSampleUpdate(plmt_t* mt, memptr_t pointer, memptr_t newPointer, size_t newSize){
+	plmtsampler_t* sampler = mt->sampler;
+	size_t filterSlot = plMTSampleHash(pointer);
+
+	if(pointer == NULL || __atomic_load_n(&sampler->filter[filterSlot], __ATOMIC_RELAXED) == 0)
+		return;
+
+	pthread_mutex_lock(&sampler->lock);
+	for(size_t i = 0; i < sampler->sampleAmnt; i++){
+		if(sampler->samples[i].pointer != pointer)
+			continue;
+
+		__atomic_store_n(&sampler->filter[filterSlot], sampler->filter[filterSlot] - 1, __ATOMIC_RELAXED);
+		if(newPointer == NULL){
+			sampler->sampleAmnt--;
+			sampler->samples[i] = sampler->samples[sampler->sampleAmnt];
+		}else{
+			size_t newSlot = plMTSampleHash(newPointer);
+
+			sampler->samples[i].pointer = newPointer;
+			sampler->samples[i].size = newSize;
+			__atomic_store_n(&sampler->filter[newSlot], sampler->filter[newSlot] + 1, __ATOMIC_RELAXED);
+		}
+		break;
+	}
+	pthread_mutex_unlock(&sampler->lock);
+}
+
+/* Frees the allocation profiler of a tracker along with every sample */
+static void plMTSampleRelease(plmt_t* mt){
+	if(mt->sampler == NULL)
+		return;
+
+	pthread_mutex_destroy(&mt->sampler->lock);
+	free(mt->sampler->samples);
+	free(mt->sampler);
+	mt->sampler = NULL;
+}
+
+/* Creates and initializes a memory allocation tracker */
+plmt_t* plMTInit(size_t maxMemoryInit){
+	plmt_t* returnMT = malloc(sizeof(plmt_t));
+	if(returnMT == NULL)
+		plPanic("plMTInit: Failed to allocate memory", false, false);
+
+	returnMT->ptrList = malloc(2 * sizeof(plptr_t));
+	returnMT->ptrIndex = calloc(4, sizeof(size_t));
+	returnMT->listAmnt = 0;
+	returnMT->allocListAmnt = 2;
+	returnMT->indexSize = 4;
+	returnMT->usedMemory = 0;
+	returnMT->ownMemory = 0;
+	returnMT->externalMemory = 0;
+	returnMT->softMemory = SIZE_MAX;
+	returnMT->softCallback = NULL;
+	returnMT->hardCallback = NULL;
+	returnMT->pressureData = NULL;
+	returnMT->pressureAmnt = 0;
+	returnMT->mode = PLMT_MODE_DEFAULT;
+	returnMT->arena = NULL;
+	returnMT->arenaChunkSize = 0;
+	returnMT->arenaLast = NULL;
+	returnMT->parent = NULL;
+	returnMT->childList = NULL;
+	returnMT->nextChild = NULL;
+	returnMT->shared = NULL;
+	returnMT->nextHeap = NULL;
+	returnMT->returnQueue = NULL;
+	returnMT->isOrphaned = false;
+	memset(&returnMT->stats, 0, sizeof(plmtstats_t));
+	returnMT->sampler = NULL;
+	returnMT->backend = &plMTMallocBackend;
+	memset(returnMT->retainCache, 0, sizeof(returnMT->retainCache));
+	returnMT->retainedMemory = 0;
+	returnMT->retainLimit = 0;
+	plMTSlabSetup(returnMT, plMTDefaultSizeClasses, sizeof(plMTDefaultSizeClasses) / sizeof(size_t));
+
+	if(returnMT->ptrList == NULL || returnMT->ptrIndex == NULL)
+		plPanic("plMTInit: Failed to allocate memory", false, false);
+
+	if(pthread_mutex_init(&returnMT->childLock, NULL))
+		plPanic("plMTInit: Failed to initialize child tracker lock", false, false);
+
+	if(!maxMemoryInit){
+		returnMT->maxMemory = 128 * 1024 * 1024;
+	}else{
+		returnMT->maxMemory = maxMemoryInit;
+	}
+
+	return returnMT;
+}
+
+/* Creates and initializes an arena memory allocation tracker. Allocations are *\
+|* carved out of chunks of chunkSize bytes, plMTFree only reclaims the latest  *|
+\* allocation, and everything is released at once by plMTReset or plMTStop    */
+plmt_t* plMTInitArena(size_t chunkSize, size_t maxMemoryInit){
+	plmt_t* returnMT = plMTInit(maxMemoryInit);
+
+	returnMT->mode = PLMT_MODE_ARENA;
+	if(!chunkSize){
+		returnMT->arenaChunkSize = PLMT_ARENA_DEFAULT_CHUNK;
+	}else{
+		returnMT->arenaChunkSize = (chunkSize + PLMT_ARENA_ALIGN - 1) & ~(size_t)(PLMT_ARENA_ALIGN - 1);
+	}
+
+	return returnMT;
+}
+
+/* Creates and initializes a memory allocation tracker that charges every allocation to parent *\
+|* as well as to itself. maxMemoryInit limits the child, while parent keeps limiting itself   *|
+\* and all of its children combined. Child trackers are stopped along with their parent       */
+plmt_t* plMTInitChild(plmt_t* parent, size_t maxMemoryInit){
+	if(parent == NULL)
+		plPanic("plMTInitChild: Parent memory tracker was set to NULL", false, true);
+
+	plmt_t* returnMT = plMTInit(maxMemoryInit);
+	returnMT->parent = parent;
+	returnMT->backend = parent->backend;
+
+	pthread_mutex_lock(&parent->childLock);
+	returnMT->nextChild = parent->childList;
+	parent->childList = returnMT;
+	pthread_mutex_unlock(&parent->childLock);
+
+	return returnMT;
+}
+
+/* Frees every chunk of an arena tracker, except for keepChunk. Regular chunks are retained if the retain limit allows it */
+static void plMTArenaRelease(plmt_t* mt, plarenachunk_t* keepChunk){
+	plarenachunk_t* chunk = mt->arena;
+
+	while(chunk != NULL){
+		plarenachunk_t* prevChunk = chunk->prev;
+		if(chunk != keepChunk){
+			if(chunk->size == mt->arenaChunkSize)
+				plMTRetainBlock(mt, chunk, sizeof(plarenachunk_t) + chunk->size);
+			else
+				mt->backend->free(mt->backend->data, chunk);
+		}
+
+		chunk = prevChunk;
+	}
+
+	mt->arena = keepChunk;
+	if(keepChunk != NULL){
+		keepChunk->prev = NULL;
+		keepChunk->offset = 0;
+	}
+}
+
+/* Removes the pointer reference at index entry from the tracking array and releases its *\
+\* block. Returns the size of the block, which the caller has to uncharge from the tracker */
+static size_t plMTRmPtr(plmt_t* mt, size_t slot){
+	size_t entry = mt->ptrIndex[slot] - 1;
+	size_t lastEntry = mt->listAmnt - 1;
+	plptr_t rmPtr = mt->ptrList[entry];
+	plMTIndexRemove(mt, slot);
+
+	/* Move the last entry into the hole and point its index slot at the new position */
+	if(entry != lastEntry){
+		mt->ptrList[entry] = mt->ptrList[lastEntry];
+		mt->ptrIndex[plMTIndexSlot(mt, mt->ptrList[entry].pointer)] = entry + 1;
+	}
+	mt->ptrList[lastEntry].pointer = NULL;
+	mt->ptrList[lastEntry].size = 0;
+	mt->ptrList[lastEntry].sizeClass = 0;
+	mt->ptrList[lastEntry].offset = 0;
+	mt->listAmnt--;
+
+	plMTBlockFree(mt, (byte_t*)rmPtr.pointer - rmPtr.offset, rmPtr.sizeClass);
+	PLMT_STAT_ADD(mt, freeAmnt, 1);
+	return rmPtr.size;
+}
+
+/* Frees every block that other threads handed back to a heap of a shared tracker */
+static void plMTSharedDrain(plmt_t* heap){
+	memptr_t pointer = __atomic_exchange_n(&heap->returnQueue, NULL, __ATOMIC_ACQUIRE);
+	size_t freedMemory = 0;
+
+	while(pointer != NULL){
+		memptr_t nextPointer = ((plsharedheader_t*)((byte_t*)pointer - PLMT_SHARED_HEADER))->data.next;
+		size_t slot = plMTIndexSlot(heap, pointer);
+
+		if(heap->ptrIndex[slot] != 0)
+			freedMemory += plMTRmPtr(heap, slot);
+
+		pointer = nextPointer;
+	}
+
+	plMTUncharge(heap, freedMemory);
+}
+
+/* Called when a thread exits, so another thread can adopt its heap and any blocks still in it */
+static void plMTSharedOrphan(memptr_t heapPtr){
+	plmt_t* heap = heapPtr;
+
+	plMTSharedDrain(heap);
+	__atomic_store_n(&heap->isOrphaned, true, __ATOMIC_RELEASE);
+}
+
+/* Gets the heap of the calling thread, adopting an orphaned heap or creating a new one if needed */
+static plmt_t* plMTSharedHeap(plmt_t* mt){
+	plmt_t* heap = pthread_getspecific(mt->shared->heapKey);
+
+	if(heap != NULL)
+		return heap;
+
+	pthread_mutex_lock(&mt->shared->heapLock);
+	for(heap = mt->shared->heapList; heap != NULL; heap = heap->nextHeap){
+		bool isOrphaned = true;
+		if(__atomic_compare_exchange_n(&heap->isOrphaned, &isOrphaned, false, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+	}
+
+	if(heap == NULL){
+		heap = plMTInit(SIZE_MAX);
+		heap->parent = mt;
+		heap->backend = mt->backend;
+		heap->nextHeap = mt->shared->heapList;
+		mt->shared->heapList = heap;
+	}
+	pthread_mutex_unlock(&mt->shared->heapLock);
+
+	if(pthread_setspecific(mt->shared->heapKey, heap))
+		plPanic("plMTSharedHeap: Failed to set thread heap", false, false);
+
+	return heap;
+}
+
+/* Creates and initializes a memory allocation tracker that can be used from any thread. Each  *\
+|* thread allocates from a heap of its own without taking any locks, blocks freed by another  *|
+|* thread go back to their owner through a lock-free queue, and maxMemory applies to all of   *|
+\* the heaps combined                                                                          */
+plmt_t* plMTInitShared(size_t maxMemoryInit){
+	plmt_t* returnMT = plMTInit(maxMemoryInit);
+
+	returnMT->mode = PLMT_MODE_SHARED;
+	returnMT->shared = malloc(sizeof(plmtshared_t));
+	if(returnMT->shared == NULL)
+		plPanic("plMTInitShared: Failed to allocate memory", false, false);
+
+	returnMT->shared->heapList = NULL;
+	if(pthread_key_create(&returnMT->shared->heapKey, plMTSharedOrphan) || pthread_mutex_init(&returnMT->shared->heapLock, NULL))
+		plPanic("plMTInitShared: Failed to initialize thread heaps", false, false);
+
+	return returnMT;
+}
+
+/* Frees all pointers currently in the memory allocation tracker, keeping the tracker itself. *\
+\* Shared trackers must not be in use by any other thread while they're being reset          */
+void plMTReset(plmt_t* mt){
+	if(mt == NULL)
+		return;
+
+	if(mt->sampler != NULL){
+		mt->sampler->sampleAmnt = 0;
+		memset(mt->sampler->filter, 0, sizeof(mt->sampler->filter));
+	}
+
+	if(mt->retainedMemory > mt->retainLimit)
+		plMTRetainRelease(mt);
+
+	if(mt->mode == PLMT_MODE_SHARED){
+		for(plmt_t* heap = mt->shared->heapList; heap != NULL; heap = heap->nextHeap){
+			heap->retainLimit = mt->retainLimit;
+			plMTSharedDrain(heap);
+			plMTReset(heap);
+		}
+
+		return;
+	}
+
+	if(mt->mode == PLMT_MODE_ARENA){
+		/* Keep the current chunk around if it's a regular one, so the next cycle doesn't need to allocate */
+		plarenachunk_t* keepChunk = mt->arena;
+		if(keepChunk != NULL && keepChunk->size != mt->arenaChunkSize)
+			keepChunk = NULL;
+
+		plMTArenaRelease(mt, keepChunk);
+		mt->arenaLast = NULL;
+		PLMT_STAT_ADD(mt, freeAmnt, mt->stats.allocAmnt - mt->stats.freeAmnt);
+	}else{
+		for(size_t i = 0; i < mt->listAmnt; i++){
+			memptr_t block = (byte_t*)mt->ptrList[i].pointer - mt->ptrList[i].offset;
+
+			if(mt->ptrList[i].sizeClass == 0 && mt->retainLimit != 0)
+				plMTRetainBlock(mt, block, mt->ptrList[i].size + mt->ptrList[i].offset);
+			else
+				plMTBlockFree(mt, block, mt->ptrList[i].sizeClass);
+		}
+
+		memset(mt->ptrIndex, 0, mt->indexSize * sizeof(size_t));
+		PLMT_STAT_ADD(mt, freeAmnt, mt->listAmnt);
+		mt->listAmnt = 0;
+	}
+
+	plMTUncharge(mt, mt->ownMemory);
+}
+
+/* Frees all pointers currently in the memory allocation tracker and the tracker itself. *\
+\* Shared trackers must not be in use by any other thread while they're being stopped   */
+void plMTStop(plmt_t* mt){
+	/* Stop every child first, each of them unlinks itself from this tracker */
+	while(true){
+		pthread_mutex_lock(&mt->childLock);
+		plmt_t* child = mt->childList;
+		pthread_mutex_unlock(&mt->childLock);
+
+		if(child == NULL)
+			break;
+
+		plMTStop(child);
+	}
+
+	if(mt->parent != NULL){
+		plmt_t** childPtr = &mt->parent->childList;
+
+		pthread_mutex_lock(&mt->parent->childLock);
+		while(*childPtr != NULL && *childPtr != mt)
+			childPtr = &(*childPtr)->nextChild;
+
+		if(*childPtr != NULL)
+			*childPtr = mt->nextChild;
+		pthread_mutex_unlock(&mt->parent->childLock);
+	}
+
+	if(mt->mode == PLMT_MODE_SHARED){
+		plmt_t* heap = mt->shared->heapList;
+
+		while(heap != NULL){
+			plmt_t* nextHeap = heap->nextHeap;
+			plMTSharedDrain(heap);
+			heap->parent = NULL;
+			plMTStop(heap);
+			heap = nextHeap;
+		}
+
+		pthread_key_delete(mt->shared->heapKey);
+		pthread_mutex_destroy(&mt->shared->heapLock);
+		free(mt->shared);
+	}
+
+	for(size_t i = 0; i < mt->listAmnt; i++){
+		if(mt->ptrList[i].sizeClass == 0)
+			mt->backend->free(mt->backend->data, (byte_t*)mt->ptrList[i].pointer - mt->ptrList[i].offset);
+	}
+	plMTUncharge(mt, mt->ownMemory);
+	plMTUnchargeChain(mt, mt->externalMemory);
+	plMTSampleRelease(mt);
+	plMTSlabRelease(mt);
+	mt->retainLimit = 0;
+	plMTRetainRelease(mt);
+	plMTArenaRelease(mt, NULL);
+	pthread_mutex_destroy(&mt->childLock);
+	free(mt->ptrIndex);
+	free(mt->ptrList);
+	free(mt);
+}
+
+/* Bump-allocates a block from the current arena chunk, creating a new chunk if it doesn't fit */
+static memptr_t plMTArenaAlloc(plmt_t* mt, size_t size, size_t alignment){
+	size_t dataSize = (size + PLMT_ARENA_ALIGN - 1) & ~(size_t)(PLMT_ARENA_ALIGN - 1);
+	size_t padding = (alignment > PLMT_MIN_ALIGN) ? alignment - PLMT_MIN_ALIGN : 0;
+	size_t blockSize = PLMT_ARENA_ALIGN + dataSize + padding;
+
+	if(dataSize < size || blockSize < dataSize || !plMTCharge(mt, size))
+		return NULL;
+
+	plarenachunk_t* chunk = mt->arena;
+
+	if(chunk == NULL || chunk->size - chunk->offset < blockSize){
+		size_t chunkSize = mt->arenaChunkSize;
+		if(blockSize > chunkSize)
+			chunkSize = blockSize;
+
+		plarenachunk_t* newChunk = NULL;
+		if(mt->retainedMemory != 0)
+			newChunk = plMTRetainTake(mt, sizeof(plarenachunk_t) + chunkSize);
+		if(newChunk == NULL)
+			newChunk = mt->backend->alloc(mt->backend->data, sizeof(plarenachunk_t) + chunkSize, false);
+		if(newChunk == NULL){
+			plMTUncharge(mt, size);
+			return NULL;
+		}
+
+		newChunk->size = chunkSize;
+		newChunk->offset = 0;
+
+		/* Oversized chunks go behind the current chunk so its leftover space can still be used */
+		if(chunk != NULL && chunkSize > mt->arenaChunkSize && chunk->size - chunk->offset >= PLMT_ARENA_ALIGN * 2){
+			newChunk->prev = chunk->prev;
+			chunk->prev = newChunk;
+			chunk = newChunk;
+		}else{
+			newChunk->prev = chunk;
+			mt->arena = newChunk;
+			chunk = newChunk;
+		}
+	}
+
+	byte_t* block = (byte_t*)(chunk + 1) + chunk->offset;
+	if(padding != 0)
+		block += (alignment - ((uintptr_t)block + PLMT_ARENA_ALIGN) % alignment) % alignment;
+
+	*((size_t*)block) = size;
+	chunk->offset = block + PLMT_ARENA_ALIGN + dataSize - (byte_t*)(chunk + 1);
+
+	PLMT_STAT_ALLOC(mt, size);
+	mt->arenaLast = block + PLMT_ARENA_ALIGN;
+	return mt->arenaLast;
+}
+
+/* Reclaims an arena block only if it's the latest allocation of the current chunk */
+static void plMTArenaFree(plmt_t* mt, memptr_t pointer){
+	plarenachunk_t* chunk = mt->arena;
+
+	if(pointer == NULL)
+		return;
+
+	PLMT_STAT_ADD(mt, freeAmnt, 1);
+	if(pointer != mt->arenaLast)
+		return;
+
+	byte_t* header = (byte_t*)pointer - PLMT_ARENA_ALIGN;
+	if(header < (byte_t*)(chunk + 1) || header >= (byte_t*)(chunk + 1) + chunk->size)
+		return;
+
+	plMTUncharge(mt, *((size_t*)header));
+	mt->arenaLast = NULL;
+	chunk->offset = header - (byte_t*)(chunk + 1);
+}
+
+/* Resizes an arena block in place if it's the latest allocation, otherwise copies it into a new block */
+static memptr_t plMTArenaRealloc(plmt_t* mt, memptr_t pointer, size_t size, size_t alignment){
+	if(pointer == NULL)
+		return NULL;
+
+	plarenachunk_t* chunk = mt->arena;
+	size_t* header = (size_t*)((byte_t*)pointer - PLMT_ARENA_ALIGN);
+	size_t oldSize = *header;
+	bool isLast = pointer == mt->arenaLast && (byte_t*)header >= (byte_t*)(chunk + 1) && (byte_t*)header < (byte_t*)(chunk + 1) + chunk->size;
+
+	if(isLast && (uintptr_t)pointer % alignment == 0){
+		size_t blockStart = (byte_t*)header - (byte_t*)(chunk + 1);
+		size_t blockSize = PLMT_ARENA_ALIGN + ((size + PLMT_ARENA_ALIGN - 1) & ~(size_t)(PLMT_ARENA_ALIGN - 1));
+
+		if(blockSize >= size && chunk->size - blockStart >= blockSize){
+			if(size > oldSize && !plMTCharge(mt, size - oldSize))
+				return NULL;
+			else if(size < oldSize)
+				plMTUncharge(mt, oldSize - size);
+
+			chunk->offset = blockStart + blockSize;
+			*header = size;
+			PLMT_STAT_ADD(mt, reallocAmnt, 1);
+			return pointer;
+		}
+	}
+
+	size_t oldOffset = (chunk != NULL) ? chunk->offset : 0;
+	memptr_t tempPtr = plMTArenaAlloc(mt, size, alignment);
+	if(tempPtr == NULL)
+		return NULL;
+
+	memcpy(tempPtr, pointer, (oldSize < size) ? oldSize : size);
+
+	/* A moved latest block is uncharged, and reclaimed too if the copy went into another chunk. *\
+	\* Any other old block stays in the arena as good as freed and stays charged until plMTReset */
+	if(isLast){
+		plMTUncharge(mt, oldSize);
+		if(chunk->offset == oldOffset)
+			chunk->offset = (byte_t*)header - (byte_t*)(chunk + 1);
+	}
+	PLMT_STAT_ADD(mt, reallocAmnt, 1);
+	PLMT_STAT_ADD(mt, freeAmnt, 1);
+	return tempPtr;
+}
+
+/* Adds a pointer reference to the tracking array */
+static void plMTAddPtr(plmt_t* mt, memptr_t ptr, size_t size, uint32_t sizeClass, uint32_t offset){
+	if(mt->listAmnt >= mt->allocListAmnt){
+		memptr_t tempPtr = realloc(mt->ptrList, mt->allocListAmnt * 2 * sizeof(plptr_t));
+
+		if(tempPtr == NULL)
+			plPanic("plMTManage: Failed to resize array", false, false);
+
+		mt->ptrList = tempPtr;
+		mt->allocListAmnt *= 2;
+
+		/* Keep the index at most half full so probe sequences stay short */
+		if(mt->indexSize < mt->allocListAmnt * 2)
+			plMTIndexRebuild(mt, mt->allocListAmnt * 2);
+	}
+
+	mt->ptrList[mt->listAmnt].pointer = ptr;
+	mt->ptrList[mt->listAmnt].size = size;
+	mt->ptrList[mt->listAmnt].sizeClass = sizeClass;
+	mt->ptrList[mt->listAmnt].offset = offset;
+	mt->ptrIndex[plMTIndexSlot(mt, ptr)] = mt->listAmnt + 1;
+	mt->listAmnt++;
+}
+
+/* Charges, allocates and tracks a block with at least offset bytes of room in front of the returned *\
+\* pointer. The pointer gets aligned to alignment bytes by padding the front of the block if needed */
+static memptr_t plMTTrackedAlloc(plmt_t* mt, size_t size, bool zeroed, uint32_t offset, size_t alignment){
+	size_t padding = (alignment > PLMT_MIN_ALIGN) ? alignment - PLMT_MIN_ALIGN : 0;
+	uint32_t sizeClass;
+	byte_t* block;
+
+	if(size + offset + padding < size || !plMTCharge(mt, size))
+		return NULL;
+
+	if((block = plMTBlockAlloc(mt, size + offset + padding, zeroed, &sizeClass)) == NULL){
+		plMTUncharge(mt, size);
+		return NULL;
+	}
+
+	byte_t* pointer = block + offset;
+	if(padding != 0)
+		pointer += (alignment - (uintptr_t)pointer % alignment) % alignment;
+
+	plMTAddPtr(mt, pointer, size, sizeClass, pointer - block);
+	PLMT_STAT_ALLOC(mt, size);
+	return pointer;
+}
+
+/* Resizes the tracked block at index slot, moving it between slabs and malloc if needed */
+static memptr_t plMTTrackedRealloc(plmt_t* mt, size_t slot, size_t size){
+	size_t entry = mt->ptrIndex[slot] - 1;
+	plptr_t* reallocEntry = &mt->ptrList[entry];
+	byte_t* oldBlock = (byte_t*)reallocEntry->pointer - reallocEntry->offset;
+	byte_t* newBlock = oldBlock;
+	size_t blockSize = size + reallocEntry->offset;
+
+	if(blockSize < size)
+		return NULL;
+
+	if(size > reallocEntry->size){
+		memptr_t pointer = reallocEntry->pointer;
+
+		if(!plMTCharge(mt, size - reallocEntry->size))
+			return NULL;
+
+		/* A pressure callback might have freed other blocks, moving this one within the pointer list */
+		slot = plMTIndexSlot(mt, pointer);
+		entry = mt->ptrIndex[slot] - 1;
+		reallocEntry = &mt->ptrList[entry];
+	}
+
+	/* Slab blocks stay put as long as the new size maps to the same size class. *\
+	\* Otherwise, the contents get moved to a block of the right kind            */
+	if(reallocEntry->sizeClass != 0){
+		uint32_t newSizeClass = plMTSlabClass(mt, blockSize);
+
+		if(newSizeClass != reallocEntry->sizeClass){
+			newBlock = plMTBlockAlloc(mt, blockSize, false, &newSizeClass);
+			if(newBlock == NULL)
+				plPanic("plMTManage: Couldn't reallocate memory", false, false);
+
+			memcpy(newBlock, oldBlock, reallocEntry->offset + ((reallocEntry->size < size) ? reallocEntry->size : size));
+			plMTSlabFree(mt, oldBlock, reallocEntry->sizeClass);
+			reallocEntry->sizeClass = newSizeClass;
+		}
+	}else{
+		newBlock = mt->backend->realloc(mt->backend->data, oldBlock, blockSize);
+		if(newBlock == NULL)
+			plPanic("plMTManage: Couldn't reallocate memory", false, false);
+	}
+
+	if(size < reallocEntry->size)
+		plMTUncharge(mt, reallocEntry->size - size);
+
+	/* The block might have moved, so its index slot has to be rehashed */
+	if(newBlock != oldBlock){
+		plMTIndexRemove(mt, slot);
+		reallocEntry->pointer = newBlock + reallocEntry->offset;
+		mt->ptrIndex[plMTIndexSlot(mt, reallocEntry->pointer)] = entry + 1;
+	}
+
+	reallocEntry->size = size;
+	PLMT_STAT_ADD(mt, reallocAmnt, 1);
+	return reallocEntry->pointer;
+}
+
+/* An internal control function for the memory allocation tracker */
+int plMTManage(plmt_t* mt, plmtiaction_t mode, memptr_t ptr, size_t size){
+	if(mt == NULL){
+		return 1;
+	}
+
+	switch(mode){
+		/* Searches pointer address within the tracking array */
+		case PLMT_SEARCHPTR: ;
+			size_t searchSlot = plMTIndexSlot(mt, ptr);
+
+			if(ptr == NULL || mt->ptrIndex[searchSlot] == 0)
+				return -1;
+
+			return mt->ptrIndex[searchSlot] - 1;
+		/* Adds pointer reference to the tracking array */
+		case PLMT_ADDPTR:
+			plMTAddPtr(mt, ptr, size, 0, 0);
+			mt->usedMemory += size;
+			break;
+		/* Removes pointer reference from the tracking array */
+		case PLMT_RMPTR: ;
+			if(ptr == NULL)
+				return 1;
+
+			size_t rmSlot = plMTIndexSlot(mt, ptr);
+			if(mt->ptrIndex[rmSlot] == 0)
+				return 1;
+
+			plMTUncharge(mt, plMTRmPtr(mt, rmSlot));
+			break;
+		/* Special mode for just realloc() */
+		case PLMT_REALLOC: ;
+			if(*((void**)ptr) == NULL)
+				return 1;
+
+			size_t reallocSlot = plMTIndexSlot(mt, *((void**)ptr));
+			if(mt->ptrIndex[reallocSlot] == 0)
+				return 1;
+
+			void* tempPtr = plMTTrackedRealloc(mt, reallocSlot, size);
+			if(tempPtr == NULL)
+				return 1;
+
+			*((void**)ptr) = tempPtr;
+			break;
+		default:
+			return 1;
+	}
+	return 0;
+}
+
+/* Get the current memory usage or the maximum memory usage limit, or set a new *\
+|* maximum memory usage limit. Memory usage includes every child tracker, whose *|
+\* combined or individual usage (by child index) can also be queried            */
+size_t plMTMemAmnt(plmt_t* mt, plmtaction_t action, size_t size){
+	switch(action){
+		case PLMT_GET_USEDMEM:
+			return __atomic_load_n(&mt->usedMemory, __ATOMIC_RELAXED);
+		case PLMT_GET_MAXMEM:
+			return __atomic_load_n(&mt->maxMemory, __ATOMIC_RELAXED);
+		case PLMT_SET_MAXMEM:
+			__atomic_store_n(&mt->maxMemory, size, __ATOMIC_RELAXED);
+			break;
+		case PLMT_GET_CHILDMEM:
+			return __atomic_load_n(&mt->usedMemory, __ATOMIC_RELAXED) - mt->ownMemory - __atomic_load_n(&mt->externalMemory, __ATOMIC_RELAXED);
+		case PLMT_GET_CHILDAMNT: ;
+			size_t childAmnt = 0;
+
+			pthread_mutex_lock(&mt->childLock);
+			for(plmt_t* child = mt->childList; child != NULL; child = child->nextChild)
+				childAmnt++;
+			pthread_mutex_unlock(&mt->childLock);
+
+			return childAmnt;
+		case PLMT_GET_CHILDUSEDMEM: ;
+			size_t childMemory = 0;
+			plmt_t* child;
+
+			pthread_mutex_lock(&mt->childLock);
+			for(child = mt->childList; child != NULL && size > 0; child = child->nextChild)
+				size--;
+
+			if(child != NULL)
+				childMemory = __atomic_load_n(&child->usedMemory, __ATOMIC_RELAXED);
+			pthread_mutex_unlock(&mt->childLock);
+
+			return childMemory;
+		case PLMT_GET_PEAKMEM:
+		case PLMT_GET_LIVEAMNT: ;
+			plmtstats_t stats;
+
+			plMTGetStats(mt, &stats);
+			return (action == PLMT_GET_PEAKMEM) ? stats.peakMemory : stats.liveAmnt;
+		case PLMT_GET_SOFTMEM: ;
+			size_t softMemory = __atomic_load_n(&mt->softMemory, __ATOMIC_RELAXED);
+
+			return (softMemory == SIZE_MAX) ? 0 : softMemory;
+		case PLMT_SET_SOFTMEM:
+			__atomic_store_n(&mt->softMemory, (size == 0) ? SIZE_MAX : size, __ATOMIC_RELAXED);
+			break;
+		case PLMT_GET_PRESSUREAMNT:
+			return __atomic_load_n(&mt->pressureAmnt, __ATOMIC_RELAXED);
+		case PLMT_GET_RETAINMEM:
+			return mt->retainLimit;
+		case PLMT_SET_RETAINMEM:
+			mt->retainLimit = size;
+			break;
+		case PLMT_GET_CACHEDMEM: ;
+			size_t cachedMemory = __atomic_load_n(&mt->retainedMemory, __ATOMIC_RELAXED);
+
+			if(mt->mode == PLMT_MODE_SHARED){
+				pthread_mutex_lock(&mt->shared->heapLock);
+				for(plmt_t* heap = mt->shared->heapList; heap != NULL; heap = heap->nextHeap)
+					cachedMemory += __atomic_load_n(&heap->retainedMemory, __ATOMIC_RELAXED);
+				pthread_mutex_unlock(&mt->shared->heapLock);
+			}
+
+			return cachedMemory;
+	}
+	return 0;
+}
+
+#ifndef PL32LIBNG_DISABLE_MTSTATS
+/* Adds the counters of one tracker to a statistics snapshot */
+static void plMTStatsAdd(plmt_t* mt, plmtstats_t* stats){
+	stats->allocAmnt += __atomic_load_n(&mt->stats.allocAmnt, __ATOMIC_RELAXED);
+	stats->freeAmnt += __atomic_load_n(&mt->stats.freeAmnt, __ATOMIC_RELAXED);
+	stats->reallocAmnt += __atomic_load_n(&mt->stats.reallocAmnt, __ATOMIC_RELAXED);
+	stats->failAmnt += __atomic_load_n(&mt->stats.failAmnt, __ATOMIC_RELAXED);
 
-	abort();
+	for(int i = 0; i < PLMT_HISTOGRAM_SIZE; i++)
+		stats->histogram[i] += __atomic_load_n(&mt->stats.histogram[i], __ATOMIC_RELAXED);
 }
+#endif
 
-/* Creates and initializes a memory allocation tracker */
-plmt_t* plMTInit(size_t maxMemoryInit){
-	plmt_t* returnMT = malloc(sizeof(plmt_t));
-	returnMT->ptrList = malloc(2 * sizeof(plptr_t));
-	returnMT->listAmnt = 0;
-	returnMT->allocListAmnt = 2;
-	returnMT->usedMemory = 0;
+/* Takes a snapshot of the allocation statistics of a tracker. Counters only cover the *\
+|* allocations made through the tracker itself, except for peakMemory, which follows   *|
+|* usedMemory and therefore includes child trackers. Shared trackers add up the        *|
+\* counters of every thread. Returns 1 if statistics were disabled at compile time     */
+int plMTGetStats(plmt_t* mt, plmtstats_t* stats){
+	if(mt == NULL || stats == NULL)
+		return 1;
 
-	if(returnMT == NULL || returnMT->ptrList == NULL)
-		plPanic("plMTInit: Failed to allocate memory", false, false);
+	memset(stats, 0, sizeof(plmtstats_t));
 
-	if(!maxMemoryInit){
-		returnMT->maxMemory = 128 * 1024 * 1024;
-	}else{
-		returnMT->maxMemory = maxMemoryInit;
+#ifndef PL32LIBNG_DISABLE_MTSTATS
+	plMTStatsAdd(mt, stats);
+	if(mt->mode == PLMT_MODE_SHARED){
+		pthread_mutex_lock(&mt->shared->heapLock);
+		for(plmt_t* heap = mt->shared->heapList; heap != NULL; heap = heap->nextHeap)
+			plMTStatsAdd(heap, stats);
+		pthread_mutex_unlock(&mt->shared->heapLock);
 	}
 
-	return returnMT;
+	stats->liveAmnt = stats->allocAmnt - stats->freeAmnt;
+	stats->peakMemory = __atomic_load_n(&mt->stats.peakMemory, __ATOMIC_RELAXED);
+	return 0;
+#else
+	return 1;
+#endif
 }
 
-/* Frees all pointers currently in the memory allocation tracker and the tracker itself */
-void plMTStop(plmt_t* mt){
-	for(int i = 0; i < mt->listAmnt; i++){
-		free(mt->ptrList[i].pointer);
+/* Sets the block sizes that small allocations get rounded up to and served from slabs. *\
+|* Sizes are rounded up to a multiple of 16 bytes, and sizes over 1024 bytes as well   *|
+|* as anything past the 16th size class are ignored. An amount of 0 sends every        *|
+\* allocation to malloc. Fails if any slab block is still in use                       */
+int plMTSetSizeClasses(plmt_t* mt, size_t* sizeClasses, size_t amount){
+	if(mt == NULL || (sizeClasses == NULL && amount != 0) || mt->mode == PLMT_MODE_SHARED)
+		return 1;
+
+	for(size_t i = 0; i < mt->listAmnt; i++){
+		if(mt->ptrList[i].sizeClass != 0)
+			return 1;
 	}
-	free(mt->ptrList);
-	free(mt);
+
+	plMTSlabRelease(mt);
+	plMTSlabSetup(mt, sizeClasses, amount);
+	return 0;
 }
 
-/* An internal control function for the memory allocation tracker */
-int plMTManage(plmt_t* mt, plmtiaction_t mode, memptr_t ptr, size_t size){
-	if(mt == NULL){
+/* Sets the allocator that a tracker gets its blocks from (except for small blocks, which *\
+|* are carved out of slabs). Child trackers and thread heaps created afterwards use the   *|
+\* same backend. Fails if the tracker already has any memory allocated                    */
+int plMTSetBackend(plmt_t* mt, const plmtbackend_t* backend){
+	if(mt == NULL || backend == NULL || mt->listAmnt != 0 || mt->arena != NULL || mt->retainedMemory != 0 || (mt->mode == PLMT_MODE_SHARED && mt->shared->heapList != NULL))
+		return 1;
+
+	mt->backend = backend;
+	return 0;
+}
+
+/* Charges memory that wasn't allocated through a tracker, such as a file mapping, to the tracker *\
+|* and every tracker above it. It's kept apart from tracked allocations, so plMTReset doesn't    *|
+\* give it back. Returns 1 if a memory limit would be exceeded                                   */
+int plMTChargeExternal(plmt_t* mt, size_t size){
+	if(mt == NULL || !plMTChargeLimits(mt, size))
+		return 1;
+
+	__atomic_add_fetch(&mt->externalMemory, size, __ATOMIC_RELAXED);
+	return 0;
+}
+
+/* Gives back memory charged with plMTChargeExternal */
+void plMTUnchargeExternal(plmt_t* mt, size_t size){
+	if(mt == NULL)
+		return;
+
+	plMTUnchargeChain(mt, size);
+	__atomic_sub_fetch(&mt->externalMemory, size, __ATOMIC_RELAXED);
+}
+
+/* Sets the functions that get called when an allocation pushes the memory usage of a tracker *\
+|* past its soft limit, and when an allocation is about to fail because of its hard limit.    *|
+|* After the hard limit callback returns, the allocation is tried once more. Callbacks get    *|
+|* the tracker whose limit was reached, which may be a parent of the allocating tracker, the  *|
+|* size of the allocation and data. They may free memory from any tracker, but they must not  *|
+\* reset or stop the tracker that is allocating                                                */
+int plMTSetPressureCallbacks(plmt_t* mt, plmtpressurefunc_t softCallback, plmtpressurefunc_t hardCallback, memptr_t data){
+	if(mt == NULL)
+		return 1;
+
+	mt->softCallback = softCallback;
+	mt->hardCallback = hardCallback;
+	mt->pressureData = data;
+	return 0;
+}
+
+/* Enables the allocation profiler of a memory tracker, which records the call stack of *\
+|* one allocation every sampleRate bytes on average. A sampleRate of 0 disables it and  *|
+\* drops every sample. Must not be called while other threads are using the tracker    */
+int plMTSetSampling(plmt_t* mt, size_t sampleRate){
+	if(mt == NULL)
 		return 1;
+
+	if(sampleRate == 0){
+		plMTSampleRelease(mt);
+		return 0;
 	}
 
-	switch(mode){
-		/* Searches pointer address within the tracking array */
-		case PLMT_SEARCHPTR: ;
-			int i = 0;
-			while(mt->ptrList[i].pointer != ptr && i < mt->listAmnt)
-				i++;
+	if(mt->sampler == NULL){
+		plmtsampler_t* sampler = calloc(1, sizeof(plmtsampler_t));
+		if(sampler == NULL || (sampler->samples = malloc(16 * sizeof(plmtsample_t))) == NULL)
+			plPanic("plMTSetSampling: Failed to allocate memory", false, false);
 
-			if(mt->ptrList[i].pointer == ptr)
-				return i;
+		if(pthread_mutex_init(&sampler->lock, NULL))
+			plPanic("plMTSetSampling: Failed to initialize sample lock", false, false);
 
-			return -1;
-		/* Adds pointer reference to the tracking array */
-		case PLMT_ADDPTR:
-			if(mt->listAmnt >= mt->allocListAmnt){
-				memptr_t tempPtr = realloc(mt->ptrList, (mt->listAmnt + 1) * sizeof(plptr_t));
+		sampler->allocSampleAmnt = 16;
+		sampler->randomState = ((uint64_t)(uintptr_t)mt * UINT64_C(0x9E3779B97F4A7C15)) | 1;
+		mt->sampler = sampler;
+	}
+
+	mt->sampler->sampleRate = sampleRate;
+	return 0;
+}
+
+/* Sets the tag recorded along with every following sample of a tracker. The tag *\
+\* isn't copied, so it must stay valid for as long as the samples are dumped     */
+void plMTSetSampleTag(plmt_t* mt, string_t tag){
+	if(mt == NULL || mt->sampler == NULL)
+		return;
 
-				if(tempPtr == NULL)
-					plPanic("plMTManage: Failed to resize array", false, false);
+	__atomic_store_n(&mt->sampler->tag, tag, __ATOMIC_RELAXED);
+}
+
+/* Returns true if two samples were made with the same tag from the same call stack */
+static bool plMTSampleSameSite(plmtsample_t* sample, plmtsample_t* otherSample){
+	if(sample->tag != otherSample->tag && (sample->tag == NULL || otherSample->tag == NULL || strcmp(sample->tag, otherSample->tag) != 0))
+		return false;
+
+	return sample->frameAmnt == otherSample->frameAmnt && memcmp(sample->frames, otherSample->frames, sample->frameAmnt * sizeof(memptr_t)) == 0;
+}
+
+/* Writes the call stack of a sample, outermost frame first. Frames are written as their *\
+\* function name if there is one, as object+offset if not, and as an address otherwise   */
+static void plMTSampleWriteStack(FILE* stream, plmtsample_t* sample){
+	bool isFirst = true;
+#ifdef __GLIBC__
+	string_t* symbols = backtrace_symbols(sample->frames, sample->frameAmnt);
+#endif
+
+	if(sample->tag != NULL){
+		fputs(sample->tag, stream);
+		isFirst = false;
+	}
+
+	for(int i = sample->frameAmnt - 1; i >= 0; i--){
+		if(!isFirst)
+			fputc(';', stream);
 
-				mt->ptrList = tempPtr;
-				mt->allocListAmnt++;
+		isFirst = false;
+#ifdef __GLIBC__
+		/* backtrace_symbols() gives out "object(function+offset) [address]" */
+		string_t nameStart = (symbols != NULL) ? strchr(symbols[i], '(') : NULL;
+		string_t nameEnd = (nameStart != NULL) ? strpbrk(nameStart, "+)") : NULL;
+
+		if(nameEnd != NULL && nameEnd > nameStart + 1){
+			fwrite(nameStart + 1, 1, nameEnd - nameStart - 1, stream);
+			continue;
+		}else if(nameEnd != NULL && *nameEnd == '+' && strchr(nameEnd, ')') != NULL){
+			string_t objectStart = symbols[i];
+
+			for(string_t j = symbols[i]; j < nameStart; j++){
+				if(*j == '/')
+					objectStart = j + 1;
 			}
 
-			mt->ptrList[mt->listAmnt].pointer = ptr;
-			mt->ptrList[mt->listAmnt].size = size;
-			mt->listAmnt++;
-			mt->usedMemory += size;
-			break;
-		/* Removes pointer reference from the tracking array */
-		case PLMT_RMPTR:
-			if(ptr == NULL)
-				return 1;
+			fwrite(objectStart, 1, nameStart - objectStart, stream);
+			fwrite(nameEnd, 1, strchr(nameEnd, ')') - nameEnd, stream);
+			continue;
+		}
+#endif
+		fprintf(stream, "%p", sample->frames[i]);
+	}
 
-			int rmPtrResult = plMTManage(mt, PLMT_SEARCHPTR, ptr, 0);
-			if(rmPtrResult == -1)
-				return 1;
+	if(isFirst)
+		fputs("[unknown]", stream);
 
-			mt->usedMemory -= mt->ptrList[rmPtrResult].size;
-			mt->ptrList[rmPtrResult].pointer = mt->ptrList[mt->listAmnt - 1].pointer;
-			mt->ptrList[rmPtrResult].size = mt->ptrList[mt->listAmnt - 1].size;
-			mt->ptrList[mt->listAmnt - 1].pointer = NULL;
-			mt->ptrList[mt->listAmnt - 1].size = 0;
-			mt->listAmnt--;
+#ifdef __GLIBC__
+	free(symbols);
+#endif
+}
 
-			free(ptr);
+/* Writes every live sampled allocation to stream in folded stack format, which is one line per *\
+|* call site with its frames separated by ';' (outermost first) and followed by the estimated   *|
+\* amount of live bytes allocated there. Every sample stands for max(size, sampleRate) bytes    */
+int plMTDumpSamples(plmt_t* mt, FILE* stream){
+	if(mt == NULL || mt->sampler == NULL || stream == NULL)
+		return 1;
 
-			break;
-		/* Special mode for just realloc() */
-		case PLMT_REALLOC: ;
-			int reallocResult = plMTManage(mt, PLMT_SEARCHPTR, *((void**)ptr), 0);
-			if(reallocResult == -1)
-				return 1;
+	plmtsampler_t* sampler = mt->sampler;
+	pthread_mutex_lock(&sampler->lock);
 
-			void* tempPtr = realloc(*(void**)ptr, size);
-			if(tempPtr == NULL)
-				plPanic("plMTManage: Couldn't reallocate memory", false, false);
+	bool* isDumped = calloc(sampler->sampleAmnt + 1, sizeof(bool));
+	if(isDumped == NULL)
+		plPanic("plMTDumpSamples: Failed to allocate memory", false, false);
 
-			mt->ptrList[reallocResult].pointer = tempPtr;
-			mt->usedMemory += (int)(size - mt->ptrList[reallocResult].size);
-			mt->ptrList[reallocResult].size = size;
+	for(size_t i = 0; i < sampler->sampleAmnt; i++){
+		size_t liveBytes = 0;
 
-			*((void**)ptr) = tempPtr;
-			break;
-		default:
-			return 1;
+		if(isDumped[i])
+			continue;
+
+		for(size_t j = i; j < sampler->sampleAmnt; j++){
+			if(!isDumped[j] && plMTSampleSameSite(&sampler->samples[i], &sampler->samples[j])){
+				liveBytes += (sampler->samples[j].size > sampler->sampleRate) ? sampler->samples[j].size : sampler->sampleRate;
+				isDumped[j] = true;
+			}
+		}
+
+		plMTSampleWriteStack(stream, &sampler->samples[i]);
+		fprintf(stream, " %zu\n", liveBytes);
 	}
+
+	free(isDumped);
+	pthread_mutex_unlock(&sampler->lock);
 	return 0;
 }
 
-/* Get the current memory usage or the maximum memory usage limit, or set a new *\
-\* maximum memory usage limit                                                   */
-size_t plMTMemAmnt(plmt_t* mt, plmtaction_t action, size_t size){
-	switch(action){
-		case PLMT_GET_USEDMEM:
-			return mt->usedMemory;
-		case PLMT_GET_MAXMEM:
-			return mt->maxMemory;
-		case PLMT_SET_MAXMEM:
-			mt->maxMemory = size;
-			break;
+/* Allocates a block from the calling thread's heap of a shared tracker */
+static memptr_t plMTSharedAlloc(plmt_t* mt, size_t size, bool zeroed, size_t alignment){
+	plmt_t* heap = plMTSharedHeap(mt);
+
+	if(__atomic_load_n(&heap->returnQueue, __ATOMIC_RELAXED) != NULL)
+		plMTSharedDrain(heap);
+
+	byte_t* tempPtr = plMTTrackedAlloc(heap, size, zeroed, PLMT_SHARED_HEADER, alignment);
+	if(tempPtr != NULL){
+		plsharedheader_t* header = (plsharedheader_t*)(tempPtr - PLMT_SHARED_HEADER);
+		header->owner = (uintptr_t)heap | PLMT_SHARED_LIVE;
+		header->data.size = size;
 	}
-	return 0;
+
+	return tempPtr;
+}
+
+/* Frees a block of a shared tracker. Blocks owned by another thread are pushed into its return queue */
+static void plMTSharedFree(plmt_t* mt, memptr_t pointer){
+	plmt_t* heap = pthread_getspecific(mt->shared->heapKey);
+
+	if(pointer == NULL)
+		return;
+
+	if(heap != NULL){
+		size_t slot = plMTIndexSlot(heap, pointer);
+
+		if(heap->ptrIndex[slot] != 0){
+			__atomic_store_n(&((plsharedheader_t*)((byte_t*)pointer - PLMT_SHARED_HEADER))->owner, 0, __ATOMIC_RELAXED);
+			plMTUncharge(heap, plMTRmPtr(heap, slot));
+
+			if(__atomic_load_n(&heap->returnQueue, __ATOMIC_RELAXED) != NULL)
+				plMTSharedDrain(heap);
+
+			return;
+		}
+	}
+
+	/* Only one free can take the tag off a block, so blocks that were already freed get ignored */
+	plsharedheader_t* header = (plsharedheader_t*)((byte_t*)pointer - PLMT_SHARED_HEADER);
+	uintptr_t ownerTag = __atomic_load_n(&header->owner, __ATOMIC_RELAXED);
+
+	if(!(ownerTag & PLMT_SHARED_LIVE) || !__atomic_compare_exchange_n(&header->owner, &ownerTag, ownerTag & ~PLMT_SHARED_LIVE, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return;
+
+	plmt_t* owner = (plmt_t*)(ownerTag & ~PLMT_SHARED_LIVE);
+	memptr_t queueHead = __atomic_load_n(&owner->returnQueue, __ATOMIC_RELAXED);
+
+	do{
+		header->data.next = queueHead;
+	}while(!__atomic_compare_exchange_n(&owner->returnQueue, &queueHead, pointer, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* Resizes a block of a shared tracker. Blocks owned by another thread get moved into the calling thread's heap */
+static memptr_t plMTSharedRealloc(plmt_t* mt, memptr_t pointer, size_t size){
+	plmt_t* heap = plMTSharedHeap(mt);
+
+	if(pointer == NULL)
+		return NULL;
+
+	size_t slot = plMTIndexSlot(heap, pointer);
+	if(heap->ptrIndex[slot] != 0){
+		byte_t* tempPtr = plMTTrackedRealloc(heap, slot, size);
+
+		if(tempPtr != NULL)
+			((plsharedheader_t*)(tempPtr - PLMT_SHARED_HEADER))->data.size = size;
+
+		return tempPtr;
+	}
+
+	size_t oldSize = ((plsharedheader_t*)((byte_t*)pointer - PLMT_SHARED_HEADER))->data.size;
+	memptr_t tempPtr = plMTSharedAlloc(mt, size, false, 1);
+	if(tempPtr == NULL)
+		return NULL;
+
+	memcpy(tempPtr, pointer, (oldSize < size) ? oldSize : size);
+	plMTSharedFree(mt, pointer);
+	PLMT_STAT_ADD(plMTSharedHeap(mt), reallocAmnt, 1);
+	return tempPtr;
 }
 
 /* malloc() wrapper that interfaces with the memory allocation tracker */
 memptr_t plMTAlloc(plmt_t* mt, size_t size){
 	memptr_t tempPtr;
 
-	if(mt == NULL || mt->usedMemory + size > mt->maxMemory || (tempPtr = malloc(size)) == NULL)
+	if(mt == NULL)
 		return NULL;
 
-	plMTManage(mt, PLMT_ADDPTR, tempPtr, size);
+	switch(mt->mode){
+		case PLMT_MODE_ARENA:
+			tempPtr = plMTArenaAlloc(mt, size, 1);
+			break;
+		case PLMT_MODE_SHARED:
+			tempPtr = plMTSharedAlloc(mt, size, false, 1);
+			break;
+		default:
+			tempPtr = plMTTrackedAlloc(mt, size, false, 0, 1);
+	}
+
+	if(mt->sampler != NULL && tempPtr != NULL)
+		plMTSampleAlloc(mt, tempPtr, size, __builtin_return_address(0));
+
 	return tempPtr;
 }
 
@@ -189,10 +1793,25 @@ memptr_t plMTAllocE(plmt_t* mt, size_t size){
 memptr_t plMTCalloc(plmt_t* mt, size_t amount, size_t size){
 	memptr_t tempPtr;
 
-	if(mt == NULL|| mt->usedMemory + size > mt->maxMemory || (tempPtr = calloc(amount, size)) == NULL)
+	if(mt == NULL || (size != 0 && amount > SIZE_MAX / size))
 		return NULL;
 
-	plMTManage(mt, PLMT_ADDPTR, tempPtr, size);
+	switch(mt->mode){
+		case PLMT_MODE_ARENA:
+			if((tempPtr = plMTArenaAlloc(mt, amount * size, 1)) != NULL)
+				memset(tempPtr, 0, amount * size);
+
+			break;
+		case PLMT_MODE_SHARED:
+			tempPtr = plMTSharedAlloc(mt, amount * size, true, 1);
+			break;
+		default:
+			tempPtr = plMTTrackedAlloc(mt, amount * size, true, 0, 1);
+	}
+
+	if(mt->sampler != NULL && tempPtr != NULL)
+		plMTSampleAlloc(mt, tempPtr, amount * size, __builtin_return_address(0));
+
 	return tempPtr;
 }
 
@@ -200,18 +1819,269 @@ memptr_t plMTCalloc(plmt_t* mt, size_t amount, size_t size){
 memptr_t plMTRealloc(plmt_t* mt, memptr_t pointer, size_t size){
 	memptr_t tempPtr = pointer;
 
-	if(mt == NULL || mt->usedMemory + size > mt->maxMemory)
+	if(mt == NULL)
+		return NULL;
+
+	switch(mt->mode){
+		case PLMT_MODE_ARENA:
+			tempPtr = plMTArenaRealloc(mt, pointer, size, 1);
+			break;
+		case PLMT_MODE_SHARED:
+			tempPtr = plMTSharedRealloc(mt, pointer, size);
+			break;
+		default:
+			if(plMTManage(mt, PLMT_REALLOC, &tempPtr, size))
+				return NULL;
+	}
+
+	if(mt->sampler != NULL && tempPtr != NULL)
+		plMTSampleUpdate(mt, pointer, tempPtr, size);
+
+	return tempPtr;
+}
+
+/* plMTAlloc() variant that aligns the returned pointer to alignment bytes, which must be a power *\
+\* of two. The block can be freed with plMTFree, but resizing it with plMTRealloc doesn't keep it aligned */
+memptr_t plMTAllocAligned(plmt_t* mt, size_t size, size_t alignment){
+	memptr_t tempPtr;
+
+	if(mt == NULL || alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > PLMT_MAX_ALIGN)
 		return NULL;
 
-	if(plMTManage(mt, PLMT_REALLOC, &tempPtr, size))
+	switch(mt->mode){
+		case PLMT_MODE_ARENA:
+			tempPtr = plMTArenaAlloc(mt, size, alignment);
+			break;
+		case PLMT_MODE_SHARED:
+			tempPtr = plMTSharedAlloc(mt, size, false, alignment);
+			break;
+		default:
+			tempPtr = plMTTrackedAlloc(mt, size, false, 0, alignment);
+	}
+
+	if(mt->sampler != NULL && tempPtr != NULL)
+		plMTSampleAlloc(mt, tempPtr, size, __builtin_return_address(0));
+
+	return tempPtr;
+}
+
+/* plMTRealloc() variant that keeps the block aligned to alignment bytes. Unless an arena block can be *\
+|* resized in place, the contents get moved to a new aligned block, so the tracker needs room for both *|
+\* blocks for a moment. On failure, the old block is left untouched                                    */
+memptr_t plMTReallocAligned(plmt_t* mt, memptr_t pointer, size_t size, size_t alignment){
+	memptr_t tempPtr;
+	size_t oldSize;
+
+	if(mt == NULL || pointer == NULL || alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > PLMT_MAX_ALIGN)
 		return NULL;
 
+	switch(mt->mode){
+		case PLMT_MODE_ARENA:
+			tempPtr = plMTArenaRealloc(mt, pointer, size, alignment);
+			break;
+		case PLMT_MODE_SHARED:
+			oldSize = ((plsharedheader_t*)((byte_t*)pointer - PLMT_SHARED_HEADER))->data.size;
+			if((tempPtr = plMTSharedAlloc(mt, size, false, alignment)) == NULL)
+				return NULL;
+
+			memcpy(tempPtr, pointer, (oldSize < size) ? oldSize : size);
+			plMTSharedFree(mt, pointer);
+			PLMT_STAT_ADD(plMTSharedHeap(mt), reallocAmnt, 1);
+			break;
+		default: ;
+			size_t slot = plMTIndexSlot(mt, pointer);
+			if(mt->ptrIndex[slot] == 0)
+				return NULL;
+
+			oldSize = mt->ptrList[mt->ptrIndex[slot] - 1].size;
+			if((tempPtr = plMTTrackedAlloc(mt, size, false, 0, alignment)) == NULL)
+				return NULL;
+
+			memcpy(tempPtr, pointer, (oldSize < size) ? oldSize : size);
+
+			/* Adding the new block may have moved the old one around in the index */
+			plMTUncharge(mt, plMTRmPtr(mt, plMTIndexSlot(mt, pointer)));
+			PLMT_STAT_ADD(mt, reallocAmnt, 1);
+	}
+
+	if(mt->sampler != NULL && tempPtr != NULL)
+		plMTSampleUpdate(mt, pointer, tempPtr, size);
+
 	return tempPtr;
 }
 
 /* free() wrapper that interfaces with the memory allocation tracker */
 void plMTFree(plmt_t* mt, memptr_t pointer){
-	plMTManage(mt, PLMT_RMPTR, pointer, 0);
+	if(mt == NULL)
+		return;
+
+	if(mt->sampler != NULL)
+		plMTSampleUpdate(mt, pointer, NULL, 0);
+
+	switch(mt->mode){
+		case PLMT_MODE_ARENA:
+			plMTArenaFree(mt, pointer);
+			break;
+		case PLMT_MODE_SHARED:
+			plMTSharedFree(mt, pointer);
+			break;
+		default:
+			plMTManage(mt, PLMT_RMPTR, pointer, 0);
+	}
+}
+
+/* Frees multiple pointers at once. The tracker and its parents only get uncharged once for *\
+\* the whole batch, and NULL or untracked pointers are skipped just like in plMTFree        */
+void plMTFreeMany(plmt_t* mt, memptr_t* pointers, size_t count){
+	size_t freedMemory = 0;
+
+	if(mt == NULL || pointers == NULL)
+		return;
+
+	if(mt->mode != PLMT_MODE_DEFAULT){
+		for(size_t i = 0; i < count; i++)
+			plMTFree(mt, pointers[i]);
+
+		return;
+	}
+
+	for(size_t i = 0; i < count; i++){
+		if(pointers[i] == NULL)
+			continue;
+
+		if(mt->sampler != NULL)
+			plMTSampleUpdate(mt, pointers[i], NULL, 0);
+
+		size_t slot = plMTIndexSlot(mt, pointers[i]);
+		if(mt->ptrIndex[slot] != 0)
+			freedMemory += plMTRmPtr(mt, slot);
+	}
+
+	plMTUncharge(mt, freedMemory);
+}
+
+/* Returns the size of a block allocated through a memory tracker, or 0 if the tracker doesn't *\
+\* know about it. Blocks of arena and shared trackers are assumed to come from the tracker     */
+size_t plMTSizeOf(plmt_t* mt, memptr_t pointer){
+	if(mt == NULL || pointer == NULL)
+		return 0;
+
+	switch(mt->mode){
+		case PLMT_MODE_ARENA:
+			return *((size_t*)((byte_t*)pointer - PLMT_ARENA_ALIGN));
+		case PLMT_MODE_SHARED:
+			return ((plsharedheader_t*)((byte_t*)pointer - PLMT_SHARED_HEADER))->data.size;
+		default: ;
+			size_t slot = plMTIndexSlot(mt, pointer);
+
+			return (mt->ptrIndex[slot] != 0) ? mt->ptrList[mt->ptrIndex[slot] - 1].size : 0;
+	}
+}
+
+/* Tells whether a memory tracker can be used from any thread (See plMTInitShared) */
+bool plMTIsShared(plmt_t* mt){
+	return mt != NULL && mt->mode == PLMT_MODE_SHARED;
+}
+
+/* Returns the amount of elements an array can hold without getting reallocated. The capacity *\
+\* isn't stored anywhere, it comes from the size of the block holding the array               */
+size_t plMTArrayCapacity(plarray_t* array, size_t elementSize){
+	if(array == NULL || elementSize == 0)
+		return 0;
+
+	if(!array->isMemAlloc)
+		return array->size;
+
+	return plMTSizeOf(array->mt, array->array) / elementSize;
+}
+
+/* Makes room for at least capacity elements in an array, allocating it through its memory *\
+\* tracker if it's empty. Arrays that weren't allocated through a memory tracker can't grow */
+int plMTArrayReserve(plarray_t* array, size_t elementSize, size_t capacity){
+	memptr_t tempPtr;
+
+	if(array == NULL || array->mt == NULL || elementSize == 0 || capacity > SIZE_MAX / elementSize || (array->array != NULL && !array->isMemAlloc))
+		return 1;
+
+	if(array->array != NULL && plMTArrayCapacity(array, elementSize) >= capacity)
+		return 0;
+
+	if(array->array == NULL)
+		tempPtr = plMTAlloc(array->mt, capacity * elementSize);
+	else
+		tempPtr = plMTRealloc(array->mt, array->array, capacity * elementSize);
+
+	if(tempPtr == NULL)
+		return 1;
+
+	array->array = tempPtr;
+	array->isMemAlloc = true;
+	return 0;
+}
+
+/* Adds amount elements to the end of an array. Arrays at least double their capacity *\
+\* whenever they run out of room, so appending one element at a time is amortized O(1) */
+int plMTArrayAppend(plarray_t* array, size_t elementSize, memptr_t elements, size_t amount){
+	if(array == NULL || elementSize == 0 || (elements == NULL && amount != 0) || array->size + amount < array->size)
+		return 1;
+
+	size_t capacity = (array->array != NULL) ? plMTArrayCapacity(array, elementSize) : 0;
+	if(array->size + amount > capacity){
+		size_t newCapacity = (capacity > SIZE_MAX / 2) ? SIZE_MAX : capacity * 2;
+
+		if(newCapacity < 4)
+			newCapacity = 4;
+		if(newCapacity < array->size + amount)
+			newCapacity = array->size + amount;
+		if(newCapacity > SIZE_MAX / elementSize)
+			newCapacity = array->size + amount;
+
+		if(plMTArrayReserve(array, elementSize, newCapacity))
+			return 1;
+	}
+
+	memcpy((byte_t*)array->array + array->size * elementSize, elements, amount * elementSize);
+	array->size += amount;
+	return 0;
+}
+
+/* Adds an element to the end of an array */
+int plMTArrayPush(plarray_t* array, size_t elementSize, memptr_t element){
+	return plMTArrayAppend(array, elementSize, element, 1);
+}
+
+/* Removes the last element of an array, copying it to element if it isn't NULL */
+int plMTArrayPop(plarray_t* array, size_t elementSize, memptr_t element){
+	if(array == NULL || array->size == 0)
+		return 1;
+
+	array->size--;
+	if(element != NULL)
+		memcpy(element, (byte_t*)array->array + array->size * elementSize, elementSize);
+
+	return 0;
+}
+
+/* Shrinks the block holding an array down to the size of the array */
+int plMTArrayShrink(plarray_t* array, size_t elementSize){
+	if(array == NULL || array->mt == NULL || elementSize == 0 || array->array == NULL || !array->isMemAlloc)
+		return 1;
+
+	if(plMTArrayCapacity(array, elementSize) == array->size)
+		return 0;
+
+	if(array->size == 0){
+		plMTFree(array->mt, array->array);
+		array->array = NULL;
+		return 0;
+	}
+
+	memptr_t tempPtr = plMTRealloc(array->mt, array->array, array->size * elementSize);
+	if(tempPtr == NULL)
+		return 1;
+
+	array->array = tempPtr;
+	return 0;
 }
 
 /* Frees a plarray_t */
@@ -219,9 +2089,8 @@ void plMTFreeArray(plarray_t* array, bool is2DArray){
 	if(array == NULL || array->mt == NULL)
 		return;
 
-	if(is2DArray){
-		for(int i = 0; i < array->size; i++)
-			plMTFree(array->mt, ((memptr_t*)array->array)[i]);
-	}
+	if(is2DArray)
+		plMTFreeMany(array->mt, array->array, array->size);
+
 	plMTFree(array->mt, array->array);
 }
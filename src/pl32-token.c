@@ -195,37 +195,26 @@ plarray_t* plParser(string_t input, plmt_t* mt){
 
 	string_t leftoverStr;
 	plarray_t* returnStruct = plMTAllocE(mt, sizeof(plarray_t));
-	returnStruct->size = 1;
-	returnStruct->array = plMTAllocE(mt, 2 * sizeof(string_t));
+	returnStruct->array = NULL;
+	returnStruct->size = 0;
+	returnStruct->isMemAlloc = true;
+	returnStruct->mt = mt;
 
 	/* First token */
 	string_t tempPtr = plTokenize(input, &leftoverStr, mt);
 	if(tempPtr == NULL)
 		plPanic("plParser: Invalid string", false, true);
 
-	((string_t*)returnStruct->array)[0] = tempPtr;
-
 	/* Keep tokenizing until there is no more string left to tokenize */
-	while((tempPtr = plTokenize(leftoverStr, &leftoverStr, mt)) != NULL){
-		returnStruct->size++;
-		string_t* tempArrPtr = plMTRealloc(mt, returnStruct->array, returnStruct->size * sizeof(string_t));
-
-		if(!tempArrPtr){
-			for(int i = 0; i < returnStruct->size; i++)
-				plMTFree(mt, ((string_t*)returnStruct->array)[i]);
-
-			plMTFree(mt, returnStruct->array);
+	do{
+		if(plMTArrayPush(returnStruct, sizeof(string_t), &tempPtr)){
+			plMTFree(mt, tempPtr);
+			plMTFreeArray(returnStruct, true);
 			plMTFree(mt, returnStruct);
 
 			plPanic("plParser: Failed to resize array", false, false);
 		}
-
-		returnStruct->array = tempArrPtr;
-		((string_t*)returnStruct->array)[returnStruct->size - 1] = tempPtr;
-	}
-
-	returnStruct->isMemAlloc = true;
-	returnStruct->mt = mt;
+	}while((tempPtr = plTokenize(leftoverStr, &leftoverStr, mt)) != NULL);
 
 	return returnStruct;
 }